@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "AffinityPlan.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/String.h>
+#include <folly/portability/GFlags.h>
+#include <folly/system/ThreadName.h>
+#include <glog/logging.h>
+
+DEFINE_bool(affinity, false, "Pin QUIC and H2 worker threads to CPUs, see AffinityPlan");
+DEFINE_string(affinity_nic,
+              "",
+              "Interface whose RX queue IRQ CPUs workers are placed on first. "
+              "Empty: start from NUMA node 0");
+DEFINE_bool(affinity_sqpoll,
+            false,
+            "Run io_uring rings in SQPOLL mode with one shared kernel thread "
+            "pinned to a CPU of the NIC's node");
+
+namespace
+{
+    // "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+    std::vector<int> parseCpuList(folly::StringPiece list)
+    {
+        std::vector<int> cpus;
+        std::vector<folly::StringPiece> ranges;
+        folly::split(',', folly::trimWhitespace(list), ranges, true);
+        for (auto range : ranges)
+        {
+            folly::StringPiece first, last;
+            if (!folly::split('-', range, first, last))
+            {
+                first = last = range;
+            }
+            auto lo = folly::tryTo<int>(first);
+            auto hi = folly::tryTo<int>(last);
+            if (!lo || !hi)
+            {
+                continue;
+            }
+            for (int cpu = *lo; cpu <= *hi; ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    std::string readSysfs(const std::string &path)
+    {
+        std::string contents;
+        folly::readFile(path.c_str(), contents);
+        return folly::trimWhitespace(contents).str();
+    }
+
+    // Numeric entries of a directory, sorted
+    std::vector<int> listNumbers(const std::string &dir, folly::StringPiece prefix = "")
+    {
+        std::vector<int> numbers;
+        if (auto *d = ::opendir(dir.c_str()))
+        {
+            while (auto *entry = ::readdir(d))
+            {
+                folly::StringPiece name(entry->d_name);
+                if (name.startsWith(prefix))
+                {
+                    name.advance(prefix.size());
+                    if (auto n = folly::tryTo<int>(name))
+                    {
+                        numbers.push_back(*n);
+                    }
+                }
+            }
+            ::closedir(d);
+        }
+        std::sort(numbers.begin(), numbers.end());
+        return numbers;
+    }
+}
+
+namespace quic::samples
+{
+    AffinityPlan &AffinityPlan::get()
+    {
+        static AffinityPlan plan;
+        return plan;
+    }
+
+    AffinityPlan::AffinityPlan()
+    {
+        if (!FLAGS_affinity)
+        {
+            return;
+        }
+        auto online = parseCpuList(readSysfs("/sys/devices/system/cpu/online"));
+        if (online.empty())
+        {
+            LOG(WARNING) << "Cannot read the online CPUs, workers are not pinned";
+            return;
+        }
+        nodeOf_.assign(online.back() + 1, -1);
+        for (int cpu : online)
+        {
+            nodeOf_[cpu] = 0;
+        }
+        // Without NUMA support in the kernel every CPU is on node 0
+        for (int node : listNumbers("/sys/devices/system/node", "node"))
+        {
+            auto path = folly::to<std::string>("/sys/devices/system/node/node", node, "/cpulist");
+            for (int cpu : parseCpuList(readSysfs(path)))
+            {
+                if (cpu < int(nodeOf_.size()) && nodeOf_[cpu] >= 0)
+                {
+                    nodeOf_[cpu] = node;
+                }
+            }
+        }
+
+        nic_ = FLAGS_affinity_nic;
+        if (!nic_.empty())
+        {
+            auto device = folly::to<std::string>("/sys/class/net/", nic_, "/device");
+            nicNode_ = std::max(folly::tryTo<int>(readSysfs(device + "/numa_node")).value_or(-1), -1);
+            // One MSI-X vector per queue, plus usually one for the device
+            for (int irq : listNumbers(device + "/msi_irqs"))
+            {
+                auto path = folly::to<std::string>("/proc/irq/", irq, "/smp_affinity_list");
+                auto cpus = parseCpuList(readSysfs(path));
+                // A vector steered to a single CPU belongs to a queue; wider
+                // masks are unmanaged defaults
+                if (cpus.size() == 1 && cpus[0] < int(nodeOf_.size()) && nodeOf_[cpus[0]] >= 0 &&
+                    std::find(irqCpus_.begin(), irqCpus_.end(), cpus[0]) == irqCpus_.end())
+                {
+                    irqCpus_.push_back(cpus[0]);
+                }
+            }
+            if (nicNode_ < 0 && !irqCpus_.empty())
+            {
+                nicNode_ = nodeOf_[irqCpus_[0]];
+            }
+            if (irqCpus_.empty())
+            {
+                LOG(WARNING) << "No per-queue IRQ affinity found for " << nic_;
+            }
+        }
+        int home = std::max(nicNode_, 0);
+
+        std::vector<int> rest;
+        for (int cpu : online)
+        {
+            if (std::find(irqCpus_.begin(), irqCpus_.end(), cpu) == irqCpus_.end())
+            {
+                rest.push_back(cpu);
+            }
+        }
+        // Home node first, then the others by node; stable keeps CPU order
+        std::stable_sort(rest.begin(),
+                         rest.end(),
+                         [&](int a, int b)
+                         {
+                             auto rank = [&](int cpu)
+                             { return nodeOf_[cpu] == home ? -1 : nodeOf_[cpu]; };
+                             return rank(a) < rank(b);
+                         });
+        if (FLAGS_affinity_sqpoll)
+        {
+            // The last home CPU that no queue interrupts
+            auto it = std::find_if(rest.rbegin(),
+                                   rest.rend(),
+                                   [&](int cpu) { return nodeOf_[cpu] == home; });
+            if (it != rest.rend())
+            {
+                sqpollCpu_ = *it;
+                rest.erase(std::next(it).base());
+            }
+            else
+            {
+                LOG(WARNING) << "No CPU left for the SQPOLL thread, not using SQPOLL";
+            }
+        }
+        order_ = irqCpus_;
+        order_.insert(order_.end(), rest.begin(), rest.end());
+        LOG(INFO) << describe();
+    }
+
+    int AffinityPlan::pinCurrentThread(Worker kind)
+    {
+        if (order_.empty())
+        {
+            return -1;
+        }
+        int cpu = kind == Worker::Quic
+                      ? order_[nextQuic_.fetch_add(1) % order_.size()]
+                      : order_[order_.size() - 1 - nextH2_.fetch_add(1) % order_.size()];
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int err = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+        if (err != 0)
+        {
+            LOG(WARNING) << "Cannot pin worker to CPU " << cpu << ": " << folly::errnoStr(err);
+            return -1;
+        }
+        LOG(INFO) << (kind == Worker::Quic ? "QUIC" : "H2") << " worker pinned to CPU " << cpu
+                  << " (node " << nodeOf_[cpu] << ")";
+        return cpu;
+    }
+
+    int AffinityPlan::pinWorkerThread()
+    {
+        if (order_.empty())
+        {
+            return -1;
+        }
+        // Pool thread names, as truncated to the kernel's 15 characters
+        auto name = folly::getCurrentThreadName().value_or("");
+        folly::StringPiece thread(name);
+        if (thread.startsWith("QuicServerWork"))
+        {
+            return pinCurrentThread(Worker::Quic);
+        }
+        if (thread.startsWith("HTTPSrvExec"))
+        {
+            return pinCurrentThread(Worker::H2);
+        }
+        return -1;
+    }
+
+    std::string AffinityPlan::describe() const
+    {
+        if (nodeOf_.empty())
+        {
+            return "CPU affinity off";
+        }
+        std::string out = "CPU affinity plan:";
+        int maxNode = *std::max_element(nodeOf_.begin(), nodeOf_.end());
+        for (int node = 0; node <= maxNode; ++node)
+        {
+            std::vector<int> cpus;
+            for (size_t cpu = 0; cpu < nodeOf_.size(); ++cpu)
+            {
+                if (nodeOf_[cpu] == node)
+                {
+                    cpus.push_back(int(cpu));
+                }
+            }
+            if (!cpus.empty())
+            {
+                folly::toAppend("\n  node ", node, ": cpus ", folly::join(",", cpus), &out);
+            }
+        }
+        if (!nic_.empty())
+        {
+            folly::toAppend("\n  nic ", nic_, " on node ", nicNode_,
+                            ", queue IRQ cpus ", folly::join(",", irqCpus_), &out);
+        }
+        folly::toAppend("\n  QUIC workers from the front, H2 workers from the back of: ",
+                        folly::join(",", order_), &out);
+        if (sqpollCpu_)
+        {
+            folly::toAppend("\n  SQPOLL thread on cpu ", *sqpollCpu_, &out);
+        }
+        return out;
+    }
+
+} // namespace quic::samples
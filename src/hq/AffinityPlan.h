@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace quic::samples
+{
+    /*
+     * Placement of worker threads on CPUs, computed once from sysfs.
+     *
+     * With --affinity the planner reads the online CPUs and their NUMA
+     * nodes, and the CPUs the IRQs of --affinity_nic's queues are steered
+     * to. Workers are then pinned in this order:
+     *
+     *   1. the NIC's IRQ CPUs, in queue order, so worker n handles the
+     *      packets its CPU receives
+     *   2. the other CPUs of the NIC's node
+     *   3. the CPUs of the remaining nodes
+     *
+     * QUIC workers take CPUs from the front of that order and H2 workers
+     * from the back, wrapping around when there are more workers than CPUs.
+     * With --affinity_sqpoll one CPU of the NIC's node is kept out of the
+     * order for the shared io_uring SQPOLL thread.
+     *
+     * Workers are pinned by the event base backend factory, which runs on
+     * the worker thread as it creates its event base. The io_uring ring and
+     * its buffer rings are allocated right after, and the per worker pools
+     * (IOBufPool, AlignedBufferPool, the caches) on the first request, so
+     * the kernel's first-touch policy places all of them on the worker's
+     * node.
+     */
+    class AffinityPlan
+    {
+    public:
+        enum class Worker
+        {
+            Quic,
+            H2,
+        };
+
+        static AffinityPlan &get();
+
+        bool enabled() const { return !order_.empty(); }
+
+        // CPU of the SQPOLL thread all rings share, if any
+        std::optional<int> sqpollCpu() const { return sqpollCpu_; }
+
+        // Pins the calling thread as the next worker of kind; the CPU, or
+        // -1 if it was left unpinned
+        int pinCurrentThread(Worker kind);
+
+        // Pins the calling thread if it is a QUIC or H2 worker, told apart
+        // by thread name; other threads, the main one included, are left
+        // alone. The CPU, or -1.
+        int pinWorkerThread();
+
+        // Multi-line description of the topology and the plan
+        std::string describe() const;
+
+    private:
+        AffinityPlan();
+
+        // NUMA node of each CPU id, -1 if offline
+        std::vector<int> nodeOf_;
+        std::string nic_;
+        int nicNode_{-1};
+        std::vector<int> irqCpus_;
+        std::vector<int> order_;
+        std::optional<int> sqpollCpu_;
+        std::atomic<size_t> nextQuic_{0};
+        std::atomic<size_t> nextH2_{0};
+    };
+
+} // namespace quic::samples
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "AlignedBufferPool.h"
+
+#include <sys/uio.h>
+
+#include <algorithm>
+
+#include <folly/String.h>
+#include <folly/io/async/EventBaseLocal.h>
+#include <folly/io/async/IoUringBackend.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+
+DEFINE_uint32(static_file_odirect_buffers,
+              256,
+              "Number of aligned O_DIRECT read buffers per worker");
+DEFINE_uint32(static_file_odirect_buffer_kb,
+              128,
+              "Size of each O_DIRECT read buffer in KB, rounded up to 4K");
+
+namespace
+{
+    void freeUnpooled(void *buf, void * /*userData*/)
+    {
+        ::free(buf);
+    }
+}
+
+namespace quic::samples
+{
+    AlignedBufferPool::AlignedBufferPool(folly::EventBase *evb, size_t count, size_t bufferSize)
+        : evb_(evb), count_(count), bufferSize_(alignUp(std::max<size_t>(bufferSize, kAlign)))
+    {
+        void *arena = nullptr;
+        if (count_ > 0 && ::posix_memalign(&arena, kAlign, count_ * bufferSize_) == 0)
+        {
+            arena_ = static_cast<uint8_t *>(arena);
+        }
+        else
+        {
+            count_ = 0;
+        }
+        free_.reserve(count_);
+        for (size_t i = count_; i > 0; --i)
+        {
+            free_.push_back(i - 1);
+        }
+
+        auto *backend = dynamic_cast<folly::IoUringBackend *>(evb_->getBackend());
+        if (backend && count_ > 0)
+        {
+            std::vector<struct iovec> iovecs(count_);
+            for (size_t i = 0; i < count_; ++i)
+            {
+                iovecs[i].iov_base = arena_ + i * bufferSize_;
+                iovecs[i].iov_len = bufferSize_;
+            }
+            int ret = ::io_uring_register_buffers(backend->ioRingPtr(), iovecs.data(), iovecs.size());
+            if (ret < 0)
+            {
+                LOG(WARNING) << "Cannot register O_DIRECT buffers with io_uring, "
+                             << "falling back to plain reads: " << folly::errnoStr(-ret);
+            }
+            registered_ = ret == 0;
+        }
+
+        statsId_ = StatsRegistry::get().addSource(
+            [this](StatsRegistry::Emit emit)
+            {
+                emit("odirect_pool.acquired", stats_.acquired.get());
+                emit("odirect_pool.exhausted", stats_.exhausted.get());
+                emit("odirect_pool.in_use", stats_.inUse.get());
+            });
+    }
+
+    AlignedBufferPool::~AlignedBufferPool()
+    {
+        StatsRegistry::get().removeSource(statsId_);
+        // The ring drops its buffer registrations when it is torn down
+        ::free(arena_);
+    }
+
+    void AlignedBufferPool::Deleter::operator()(AlignedBufferPool *pool) const
+    {
+        pool->detached_.store(true, std::memory_order_release);
+        // Whoever drops the last reference frees the pool
+        if (pool->outstanding_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete pool;
+        }
+    }
+
+    AlignedBufferPool &AlignedBufferPool::get(folly::EventBase &evb)
+    {
+        static folly::EventBaseLocal<std::unique_ptr<AlignedBufferPool, Deleter>> pools;
+        auto &pool = pools.try_emplace_with(
+            evb,
+            [&evb]
+            {
+                return std::unique_ptr<AlignedBufferPool, Deleter>(
+                    new AlignedBufferPool(&evb,
+                                          FLAGS_static_file_odirect_buffers,
+                                          size_t(FLAGS_static_file_odirect_buffer_kb) << 10));
+            });
+        return *pool;
+    }
+
+    std::unique_ptr<folly::IOBuf> AlignedBufferPool::acquire(int &bufIndex)
+    {
+        if (free_.empty())
+        {
+            stats_.exhausted.add();
+            bufIndex = -1;
+            void *buf = nullptr;
+            if (::posix_memalign(&buf, kAlign, bufferSize_) != 0)
+            {
+                throw std::bad_alloc();
+            }
+            return folly::IOBuf::takeOwnership(buf, bufferSize_, 0, freeUnpooled);
+        }
+        auto idx = free_.back();
+        free_.pop_back();
+        outstanding_.fetch_add(1, std::memory_order_relaxed);
+        stats_.acquired.add();
+        stats_.inUse.add();
+        bufIndex = registered_ ? static_cast<int>(idx) : -1;
+        return folly::IOBuf::takeOwnership(
+            arena_ + idx * bufferSize_, bufferSize_, 0, &AlignedBufferPool::freeBuffer, this);
+    }
+
+    void AlignedBufferPool::freeBuffer(void *buf, void *userData)
+    {
+        auto *pool = static_cast<AlignedBufferPool *>(userData);
+        auto *data = static_cast<uint8_t *>(buf);
+        if (pool->detached_.load(std::memory_order_acquire) || pool->evb_->isInEventBaseThread())
+        {
+            pool->release(data);
+        }
+        else
+        {
+            pool->evb_->runInEventBaseThread([pool, data] { pool->release(data); });
+        }
+    }
+
+    void AlignedBufferPool::release(uint8_t *buf)
+    {
+        if (!detached_.load(std::memory_order_acquire))
+        {
+            // On the event base thread, which owns the free list
+            free_.push_back(static_cast<uint32_t>((buf - arena_) / bufferSize_));
+            stats_.inUse.sub();
+        }
+        if (outstanding_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete this;
+        }
+    }
+
+} // namespace quic::samples
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+
+#include "ServerStats.h"
+
+namespace quic::samples
+{
+    /*
+     * Per event base pool of 4K aligned buffers for O_DIRECT reads.
+     *
+     * All buffers are carved from one aligned arena and, when the backend
+     * allows it, registered with the io_uring instance as fixed buffers so
+     * reads can use IORING_OP_READ_FIXED. A buffer is handed out wrapped in
+     * an IOBuf whose free callback puts it back on the free list, so it
+     * returns to the pool once the transport is done transmitting it.
+     *
+     * The pool is owned by its event base; it outlives it if buffers are
+     * still referenced and is freed when the last one comes back.
+     */
+    class AlignedBufferPool
+    {
+    public:
+        static constexpr size_t kAlign = 4096;
+
+        AlignedBufferPool(folly::EventBase *evb, size_t count, size_t bufferSize);
+        AlignedBufferPool(const AlignedBufferPool &) = delete;
+        AlignedBufferPool &operator=(const AlignedBufferPool &) = delete;
+
+        static AlignedBufferPool &get(folly::EventBase &evb);
+
+        /*
+         * Returns an empty IOBuf backed by an aligned buffer of
+         * bufferSize() bytes, or an unpooled aligned buffer if the pool is
+         * exhausted. bufIndex is set to the fixed buffer index, or -1 if the
+         * buffer is not registered with the ring.
+         */
+        std::unique_ptr<folly::IOBuf> acquire(int &bufIndex);
+
+        size_t bufferSize() const { return bufferSize_; }
+
+        static size_t alignDown(size_t n) { return n & ~(kAlign - 1); }
+        static size_t alignUp(size_t n) { return alignDown(n + kAlign - 1); }
+
+    private:
+        struct Deleter
+        {
+            void operator()(AlignedBufferPool *pool) const;
+        };
+
+        ~AlignedBufferPool();
+
+        static void freeBuffer(void *buf, void *userData);
+        void release(uint8_t *buf);
+
+        folly::EventBase *evb_;
+        size_t count_;
+        size_t bufferSize_;
+        uint8_t *arena_{nullptr};
+        bool registered_{false};
+        // Set once the event base dropped the pool; buffers freed after
+        // that on any thread only count down
+        std::atomic<bool> detached_{false};
+        // Buffers handed out, plus one for the event base's reference
+        std::atomic<size_t> outstanding_{1};
+        std::vector<uint32_t> free_;
+
+        struct Stats
+        {
+            WorkerCounter acquired;
+            WorkerCounter exhausted;
+            WorkerCounter inUse;
+        };
+        Stats stats_;
+        uint64_t statsId_{0};
+    };
+
+} // namespace quic::samples
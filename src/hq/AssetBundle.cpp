@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "AssetBundle.h"
+
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/String.h>
+#include <folly/Synchronized.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+
+DEFINE_string(static_bundle,
+              "",
+              "Asset bundle written by asset_packer to serve ahead of "
+              "--static_root. Rename a new bundle over it to deploy.");
+DEFINE_bool(static_bundle_mmap,
+            true,
+            "Serve bundled assets as slices of the bundle mapping instead "
+            "of reading them with io_uring");
+
+namespace
+{
+    using quic::samples::AssetBundle;
+
+    static_assert(static_cast<size_t>(quic::samples::ContentCoding::Gzip) + 1 ==
+                      quic::samples::kBundleVariants,
+                  "bundle variants follow ContentCoding");
+
+    void unmap(void *addr, void *size)
+    {
+        ::munmap(addr, reinterpret_cast<size_t>(size));
+    }
+
+    [[noreturn]] void invalid(const std::string &path, folly::StringPiece why)
+    {
+        throw std::runtime_error(folly::to<std::string>("Invalid bundle ", path, ": ", why));
+    }
+
+    bool spanFits(uint64_t offset, uint64_t length, uint64_t size)
+    {
+        return offset <= size && length <= size - offset;
+    }
+
+    // Published bundle; readers copy it only when version moves
+    struct Published
+    {
+        std::atomic<uint64_t> version{0};
+        folly::Synchronized<std::shared_ptr<const AssetBundle>> bundle;
+    };
+
+    Published &published()
+    {
+        // Never destroyed: workers may read it while the process exits
+        static auto *state = new Published();
+        return *state;
+    }
+
+    void publish(const std::string &path)
+    {
+        try
+        {
+            auto bundle = AssetBundle::load(path, FLAGS_static_bundle_mmap);
+            LOG(INFO) << "Serving " << bundle->size() << " assets from bundle " << path;
+            auto &state = published();
+            *state.bundle.wlock() = std::move(bundle);
+            // Readers that see the new version find the bundle published
+            state.version.fetch_add(1, std::memory_order_release);
+        }
+        catch (const std::exception &ex)
+        {
+            // Keep serving the previous release
+            LOG(ERROR) << ex.what();
+        }
+    }
+
+    // Watches the bundle's directory on its own thread for a new bundle
+    // renamed over the path. Writes to the served file are not deploys.
+    void watch(const std::string &path)
+    {
+        auto slash = path.rfind('/');
+        std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+        std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+        int fd = ::inotify_init1(IN_CLOEXEC);
+        if (fd < 0)
+        {
+            PLOG(ERROR) << "inotify_init1 failed, bundle updates need a restart";
+            return;
+        }
+        if (::inotify_add_watch(fd, dir.c_str(), IN_MOVED_TO) < 0)
+        {
+            PLOG(ERROR) << "Can't watch " << dir << ", bundle updates need a restart";
+            ::close(fd);
+            return;
+        }
+        std::thread(
+            [fd, path, name]
+            {
+                alignas(struct inotify_event) char buf[4096];
+                while (true)
+                {
+                    auto n = folly::readNoInt(fd, buf, sizeof(buf));
+                    if (n <= 0)
+                    {
+                        PLOG(ERROR) << "Reading bundle watch failed";
+                        return;
+                    }
+                    bool changed = false;
+                    for (char *p = buf; p < buf + n;)
+                    {
+                        auto *event = reinterpret_cast<struct inotify_event *>(p);
+                        if (event->len > 0 && name == event->name)
+                        {
+                            changed = true;
+                        }
+                        p += sizeof(struct inotify_event) + event->len;
+                    }
+                    if (changed)
+                    {
+                        publish(path);
+                    }
+                }
+            })
+            .detach();
+    }
+}
+
+namespace quic::samples
+{
+    std::shared_ptr<AssetBundle> AssetBundle::load(const std::string &path, bool mapData)
+    {
+        std::shared_ptr<AssetBundle> bundle(new AssetBundle());
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            throw std::runtime_error(
+                folly::to<std::string>("Can't open bundle ", path, ": ", folly::errnoStr(errno)));
+        }
+        bundle->file_ = folly::File(fd, true);
+        struct stat st{};
+        if (::fstat(fd, &st) != 0)
+        {
+            throw std::runtime_error(
+                folly::to<std::string>("Can't stat bundle ", path, ": ", folly::errnoStr(errno)));
+        }
+        uint64_t size = st.st_size;
+        if (size < sizeof(BundleHeader))
+        {
+            invalid(path, "truncated header");
+        }
+        void *addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            throw std::runtime_error(
+                folly::to<std::string>("Can't map bundle ", path, ": ", folly::errnoStr(errno)));
+        }
+        bundle->mapping_ = folly::IOBuf::takeOwnership(
+            addr, size, size, unmap, reinterpret_cast<void *>(size));
+        const auto *base = static_cast<const char *>(addr);
+
+        const auto &header = *reinterpret_cast<const BundleHeader *>(base);
+        if (std::memcmp(header.magic, kBundleMagic, sizeof(kBundleMagic)) != 0)
+        {
+            invalid(path, "bad magic");
+        }
+        if (header.version != kBundleVersion)
+        {
+            invalid(path, folly::to<std::string>("unsupported version ", header.version));
+        }
+        if ((header.count > 0 && (header.numBuckets == 0 || header.numSlots < header.count)) ||
+            !spanFits(stringsOffset(header), header.stringsSize, size) ||
+            header.dataOffset < stringsOffset(header) + header.stringsSize ||
+            header.dataOffset > size)
+        {
+            invalid(path, "bad index layout");
+        }
+        // The index is touched on every lookup, fault it in now
+        ::madvise(addr, header.dataOffset & ~uint64_t(4095), MADV_WILLNEED);
+        bundle->header_ = &header;
+        bundle->buckets_ = reinterpret_cast<const uint32_t *>(base + bucketsOffset());
+        bundle->slots_ = reinterpret_cast<const uint32_t *>(base + slotsOffset(header));
+        bundle->entries_ = reinterpret_cast<const BundleEntry *>(base + entriesOffset(header));
+        bundle->strings_ = base + stringsOffset(header);
+        for (uint32_t i = 0; i < header.numSlots; ++i)
+        {
+            if (bundle->slots_[i] != kEmptySlot && bundle->slots_[i] >= header.count)
+            {
+                invalid(path, "bad slot");
+            }
+        }
+
+        bundle->assets_.resize(header.count);
+        for (uint32_t i = 0; i < header.count; ++i)
+        {
+            const auto &entry = bundle->entries_[i];
+            for (const auto *span : {&entry.path, &entry.type})
+            {
+                if (!spanFits(span->offset, span->length, header.stringsSize))
+                {
+                    invalid(path, "bad string");
+                }
+            }
+            auto lastModified = formatHttpDate(entry.mtime);
+            for (size_t v = 0; v < kBundleVariants; ++v)
+            {
+                const auto &data = entry.variants[v];
+                if (data.offset == 0)
+                {
+                    continue;
+                }
+                if (data.offset < header.dataOffset || !spanFits(data.offset, data.length, size))
+                {
+                    invalid(path, "bad data span");
+                }
+                if (!spanFits(entry.etags[v].offset, entry.etags[v].length, header.stringsSize))
+                {
+                    invalid(path, "bad string");
+                }
+                auto file = std::make_unique<CachedFile>();
+                file->file = folly::File(fd, false);
+                file->stat = st;
+                file->stat.st_size = data.length;
+                file->stat.st_mtim = {entry.mtime, 0};
+                file->offset = data.offset;
+                // The handler derives the variant's ETag from it, as it does
+                // for a sidecar's manifest hash under the root
+                file->etag = bundle->string(entry.etags[v]).str();
+                file->lastModified = lastModified;
+                file->contentType = bundle->string(entry.type).str();
+                if (mapData && data.length > 0)
+                {
+                    file->mapping_ = bundle->mapping_->cloneOne();
+                    file->mapping_->trimStart(data.offset);
+                    file->mapping_->trimEnd(file->mapping_->length() - data.length);
+                }
+                bundle->assets_[i][v] = std::move(file);
+            }
+            if (!bundle->assets_[i][0])
+            {
+                invalid(path, "asset without identity variant");
+            }
+        }
+        return bundle;
+    }
+
+    void AssetBundle::start()
+    {
+        static std::once_flag started;
+        std::call_once(started,
+                       []
+                       {
+                           if (!FLAGS_static_bundle.empty())
+                           {
+                               // Watch first so a deploy racing startup
+                               // is not missed
+                               watch(FLAGS_static_bundle);
+                               publish(FLAGS_static_bundle);
+                           }
+                       });
+    }
+
+    std::shared_ptr<const AssetBundle> AssetBundle::current()
+    {
+        struct Cache
+        {
+            uint64_t version{0};
+            std::shared_ptr<const AssetBundle> bundle;
+        };
+        static thread_local Cache cache;
+        auto &state = published();
+        auto version = state.version.load(std::memory_order_acquire);
+        if (version != cache.version)
+        {
+            cache.bundle = *state.bundle.rlock();
+            cache.version = version;
+        }
+        return cache.bundle;
+    }
+
+    std::shared_ptr<const CachedFile> AssetBundle::find(folly::StringPiece path,
+                                                        const std::vector<ContentCoding> &accepted,
+                                                        ContentCoding &coding) const
+    {
+        auto idx = indexOf(path);
+        if (idx < 0)
+        {
+            return nullptr;
+        }
+        const auto &asset = assets_[idx];
+        coding = ContentCoding::Identity;
+        for (auto candidate : accepted)
+        {
+            if (asset[static_cast<size_t>(candidate)])
+            {
+                coding = candidate;
+                break;
+            }
+        }
+        // Shares ownership with the bundle
+        return std::shared_ptr<const CachedFile>(shared_from_this(),
+                                                 asset[static_cast<size_t>(coding)].get());
+    }
+
+    folly::StringPiece AssetBundle::string(const BundleSpan &span) const
+    {
+        return folly::StringPiece(strings_ + span.offset, span.length);
+    }
+
+    int64_t AssetBundle::indexOf(folly::StringPiece path) const
+    {
+        if (header_->count == 0)
+        {
+            return -1;
+        }
+        uint32_t seed = buckets_[bundleHash(path, 0) % header_->numBuckets];
+        uint32_t idx = slots_[bundleHash(path, seed) % header_->numSlots];
+        if (idx == kEmptySlot || string(entries_[idx].path) != path)
+        {
+            return -1;
+        }
+        return idx;
+    }
+
+} // namespace quic::samples
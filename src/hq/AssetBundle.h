@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <folly/File.h>
+#include <folly/Range.h>
+#include <folly/io/IOBuf.h>
+
+#include "BundleFormat.h"
+#include "FileCache.h"
+#include "StaticFileHttp.h"
+
+namespace quic::samples
+{
+    /*
+     * A release of static assets packed into one file by asset_packer (see
+     * BundleFormat.h), served from a single descriptor without a path walk
+     * or open per asset.
+     *
+     * The bundle is mapped read-only; the index is used in place. Each
+     * variant of each asset is exposed as a CachedFile on the bundle fd with
+     * its offset, so the handler reads it with io_uring like any file or,
+     * with --static_bundle_mmap, sends slices of the mapping.
+     *
+     * A bundle is immutable. --static_bundle names the one to serve; a new
+     * release is deployed by writing it next to that path and renaming it
+     * over, which replaces the published bundle without a restart. Requests
+     * in flight keep the bundle they started with. Rewriting the served file
+     * in place is not supported: its mapping is shared, so the requests
+     * still sending slices of it would see torn bodies or SIGBUS; the
+     * watcher ignores such writes.
+     */
+    class AssetBundle : public std::enable_shared_from_this<AssetBundle>
+    {
+    public:
+        AssetBundle(const AssetBundle &) = delete;
+        AssetBundle &operator=(const AssetBundle &) = delete;
+
+        // Maps and validates the bundle at path. Throws std::runtime_error
+        // if it can't be read or is not a valid bundle.
+        static std::shared_ptr<AssetBundle> load(const std::string &path, bool mapData);
+
+        // Loads --static_bundle, if set, and starts watching for deploys;
+        // later calls are ignored
+        static void start();
+
+        // This thread's view of the bundle published from --static_bundle,
+        // nullptr if none is configured or it failed to load. One atomic
+        // load until the next deploy; returned by value like
+        // ConfigStore::current().
+        static std::shared_ptr<const AssetBundle> current();
+
+        /*
+         * Looks up a request path. Returns the first variant in accepted
+         * that the asset has, setting coding to it, or else the identity
+         * variant. nullptr if the path is not bundled. The CachedFile keeps
+         * the bundle alive.
+         */
+        std::shared_ptr<const CachedFile> find(folly::StringPiece path,
+                                               const std::vector<ContentCoding> &accepted,
+                                               ContentCoding &coding) const;
+
+        size_t size() const { return assets_.size(); }
+
+    private:
+        using Asset = std::array<std::unique_ptr<CachedFile>, kBundleVariants>;
+
+        AssetBundle() = default;
+
+        folly::StringPiece string(const BundleSpan &span) const;
+        // Index of the entry for path, -1 if not bundled
+        int64_t indexOf(folly::StringPiece path) const;
+
+        folly::File file_;
+        // Whole file, every mapped slice holds a reference
+        std::unique_ptr<folly::IOBuf> mapping_;
+        const BundleHeader *header_{nullptr};
+        const uint32_t *buckets_{nullptr};
+        const uint32_t *slots_{nullptr};
+        const BundleEntry *entries_{nullptr};
+        const char *strings_{nullptr};
+        std::vector<Asset> assets_;
+    };
+
+} // namespace quic::samples
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "BandwidthShaper.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include <folly/Conv.h>
+#include <folly/String.h>
+#include <folly/io/async/EventBaseLocal.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+
+#include "ServerConfig.h"
+
+DEFINE_string(static_rate_limits,
+              "",
+              "Comma separated prefix=connKBps[:routeKBps] download rate "
+              "limits, longest prefix wins. routeKBps caps all connections "
+              "of the process together; 0 means unlimited.");
+DEFINE_uint64(static_conn_rate_kbps,
+              0,
+              "Per connection download rate limit in KB/s for paths no "
+              "--static_rate_limits rule matches. 0 disables it.");
+
+namespace
+{
+    // A burst is this much time at the full rate, but never less than one
+    // minimum block
+    constexpr double kBurstSeconds = 0.05;
+    constexpr double kMinBurst = 16 << 10;
+
+    double burstFor(double rate)
+    {
+        return std::max(rate * kBurstSeconds, kMinBurst);
+    }
+}
+
+namespace quic::samples
+{
+    TokenBucket::TokenBucket(double bytesPerSec, double burst)
+        : rate_(bytesPerSec), burst_(burst), tokens_(burst), last_(Clock::now())
+    {
+    }
+
+    void TokenBucket::refill(Clock::time_point now)
+    {
+        std::chrono::duration<double> elapsed = now - last_;
+        tokens_ = std::min(burst_, tokens_ + elapsed.count() * rate_);
+        last_ = now;
+    }
+
+    TokenBucket::Clock::duration TokenBucket::wait(size_t n, Clock::time_point now)
+    {
+        refill(now);
+        double need = std::min<double>(n, burst_);
+        if (tokens_ >= need)
+        {
+            return Clock::duration::zero();
+        }
+        return std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>((need - tokens_) / rate_));
+    }
+
+    void TokenBucket::take(size_t n)
+    {
+        tokens_ -= n;
+    }
+
+    SharedTokenBucket::SharedTokenBucket(double bytesPerSec, double burst)
+        : nsPerByte_(1e9 / bytesPerSec),
+          burst_(burst),
+          burstNs_(static_cast<int64_t>(burst * nsPerByte_))
+    {
+    }
+
+    SharedTokenBucket::Clock::duration SharedTokenBucket::wait(size_t n,
+                                                               Clock::time_point now) const
+    {
+        int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            now.time_since_epoch())
+                            .count();
+        int64_t start = std::max(fullAt_.load(std::memory_order_relaxed), nowNs);
+        auto needNs = static_cast<int64_t>(std::min<double>(n, burst_) * nsPerByte_);
+        int64_t late = start + needNs - burstNs_ - nowNs;
+        return late > 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(late))
+                        : Clock::duration::zero();
+    }
+
+    void SharedTokenBucket::take(size_t n, Clock::time_point now)
+    {
+        int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            now.time_since_epoch())
+                            .count();
+        auto costNs = static_cast<int64_t>(n * nsPerByte_);
+        int64_t fullAt = fullAt_.load(std::memory_order_relaxed);
+        while (!fullAt_.compare_exchange_weak(
+            fullAt, std::max(fullAt, nowNs) + costNs, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    BandwidthShaper::Shaping::~Shaping()
+    {
+        if (conn_)
+        {
+            conn_.reset();
+            auto it = shaper_->conns_.find(connKey_);
+            if (it != shaper_->conns_.end() && it->second.expired())
+            {
+                shaper_->conns_.erase(it);
+            }
+        }
+    }
+
+    BandwidthShaper::Clock::duration BandwidthShaper::Shaping::acquire(size_t n)
+    {
+        // Charge neither bucket unless both allow the read, so a connection
+        // held back by its own limit does not spend the route's tokens
+        auto now = Clock::now();
+        auto wait = Clock::duration::zero();
+        if (conn_)
+        {
+            wait = conn_->wait(n, now);
+        }
+        if (route_)
+        {
+            wait = std::max(wait, route_->wait(n, now));
+        }
+        if (wait > Clock::duration::zero())
+        {
+            shaper_->stats_.delayed.add();
+            return wait;
+        }
+        if (conn_)
+        {
+            conn_->take(n);
+        }
+        if (route_)
+        {
+            route_->take(n, now);
+        }
+        return wait;
+    }
+
+    BandwidthShaper::BandwidthShaper()
+    {
+        statsId_ = StatsRegistry::get().addSource(
+            [this](StatsRegistry::Emit emit)
+            {
+                emit("bandwidth_shaper.shaped", stats_.shaped.get());
+                emit("bandwidth_shaper.delayed", stats_.delayed.get());
+            });
+    }
+
+    BandwidthShaper::~BandwidthShaper()
+    {
+        StatsRegistry::get().removeSource(statsId_);
+    }
+
+    BandwidthShaper &BandwidthShaper::get(folly::EventBase &evb)
+    {
+        static folly::EventBaseLocal<std::unique_ptr<BandwidthShaper>> shapers;
+        auto &shaper = shapers.try_emplace_with(
+            evb, [] { return std::make_unique<BandwidthShaper>(); });
+        return *shaper;
+    }
+
+    std::shared_ptr<const BandwidthShaper::Rules> BandwidthShaper::rulesFor(uint64_t version,
+                                                                            folly::StringPiece spec)
+    {
+        static std::mutex mutex;
+        // Never destroyed: workers may shape while the process exits
+        static auto *latest = new std::pair<uint64_t, std::shared_ptr<const Rules>>();
+        std::lock_guard<std::mutex> guard(mutex);
+        if (latest->second && version < latest->first)
+        {
+            // A worker still on an older version until its next request
+            return std::make_shared<const Rules>(parseRules(spec));
+        }
+        if (!latest->second || version != latest->first)
+        {
+            *latest = {version, std::make_shared<const Rules>(parseRules(spec))};
+        }
+        return latest->second;
+    }
+
+    BandwidthShaper::Rules BandwidthShaper::parseRules(folly::StringPiece spec)
+    {
+        Rules rules;
+        std::vector<folly::StringPiece> items;
+        folly::split(',', spec, items, true);
+        for (auto item : items)
+        {
+            item = folly::trimWhitespace(item);
+            folly::StringPiece prefix, rates;
+            if (!folly::split('=', item, prefix, rates))
+            {
+                LOG(ERROR) << "Ignoring rate limit rule without '=': " << item;
+                continue;
+            }
+            folly::StringPiece conn = rates, route;
+            auto colon = rates.find(':');
+            if (colon != folly::StringPiece::npos)
+            {
+                conn = rates.subpiece(0, colon);
+                route = rates.subpiece(colon + 1);
+            }
+            auto connKbps = folly::tryTo<uint64_t>(folly::trimWhitespace(conn));
+            auto routeKbps = route.empty() ? folly::makeExpected<folly::ConversionCode>(uint64_t(0))
+                                           : folly::tryTo<uint64_t>(folly::trimWhitespace(route));
+            if (!connKbps || !routeKbps)
+            {
+                LOG(ERROR) << "Ignoring malformed rate limit rule: " << item;
+                continue;
+            }
+            Rule rule{folly::trimWhitespace(prefix).str(),
+                      double(*connKbps << 10),
+                      double(*routeKbps << 10),
+                      nullptr};
+            if (rule.routeRate > 0)
+            {
+                rule.route =
+                    std::make_shared<SharedTokenBucket>(rule.routeRate, burstFor(rule.routeRate));
+            }
+            rules.push_back(std::move(rule));
+        }
+        return rules;
+    }
+
+    std::unique_ptr<BandwidthShaper::Shaping> BandwidthShaper::shape(const void *conn,
+                                                                     folly::StringPiece path,
+                                                                     uint64_t routeKbps)
+    {
+        auto config = ConfigStore::current();
+        if (!rules_ || config->version != rulesVersion_)
+        {
+            rules_ = rulesFor(config->version, config->rateLimits);
+            rulesVersion_ = config->version;
+        }
+        const auto &rules = *rules_;
+        int ruleIdx = -1;
+        for (size_t i = 0; i < rules.size(); ++i)
+        {
+            if (path.startsWith(rules[i].prefix) &&
+                (ruleIdx < 0 || rules[i].prefix.size() > rules[ruleIdx].prefix.size()))
+            {
+                ruleIdx = static_cast<int>(i);
+            }
+        }
+        double connRate = ruleIdx >= 0 ? rules[ruleIdx].connRate
+                          : routeKbps  ? double(routeKbps << 10)
+                                       : double(config->connRateKbps << 10);
+        auto route = ruleIdx >= 0 ? rules[ruleIdx].route : nullptr;
+        if (connRate <= 0 && !route)
+        {
+            return nullptr;
+        }
+        auto shaping = std::make_unique<Shaping>();
+        shaping->shaper_ = this;
+        shaping->route_ = route;
+        double burst = route ? route->burst() : 0;
+        if (connRate > 0)
+        {
+            shaping->connKey_ = {conn, ruleIdx, connRate};
+            auto &weak = conns_[shaping->connKey_];
+            shaping->conn_ = weak.lock();
+            if (!shaping->conn_)
+            {
+                shaping->conn_ = std::make_shared<TokenBucket>(connRate, burstFor(connRate));
+                weak = shaping->conn_;
+            }
+            burst = burst > 0 ? std::min(burst, shaping->conn_->burst()) : shaping->conn_->burst();
+        }
+        shaping->maxBlock_ = static_cast<size_t>(burst);
+        stats_.shaped.add();
+        return shaping;
+    }
+
+} // namespace quic::samples
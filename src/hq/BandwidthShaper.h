@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <folly/Range.h>
+#include <folly/io/async/EventBase.h>
+
+#include "ServerStats.h"
+
+namespace quic::samples
+{
+    /*
+     * Byte rate limit with a burst allowance. Owned by one event base.
+     */
+    class TokenBucket
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        TokenBucket(double bytesPerSec, double burst);
+
+        // Zero if the bucket holds n bytes (a full burst for n beyond it),
+        // else how long until it does
+        Clock::duration wait(size_t n, Clock::time_point now);
+
+        // Takes n bytes; the bucket may go into debt, which later waits pay
+        void take(size_t n);
+
+        double burst() const { return burst_; }
+
+    private:
+        void refill(Clock::time_point now);
+
+        double rate_;
+        double burst_;
+        double tokens_;
+        Clock::time_point last_;
+    };
+
+    /*
+     * TokenBucket shared by every worker of the process, lock free. Kept as
+     * the time at which the bucket is full again (GCRA): taking n bytes
+     * moves it n / rate later, and n bytes are available while it is at
+     * most one burst ahead of now.
+     */
+    class SharedTokenBucket
+    {
+    public:
+        using Clock = TokenBucket::Clock;
+
+        SharedTokenBucket(double bytesPerSec, double burst);
+
+        // As TokenBucket::wait
+        Clock::duration wait(size_t n, Clock::time_point now) const;
+
+        // As TokenBucket::take; concurrent takes all count
+        void take(size_t n, Clock::time_point now);
+
+        double burst() const { return burst_; }
+
+    private:
+        // Nanoseconds per byte and of a full burst
+        const double nsPerByte_;
+        const double burst_;
+        const int64_t burstNs_;
+        // Clock::time_point the bucket is full at, in ns since the epoch
+        std::atomic<int64_t> fullAt_{0};
+    };
+
+    /*
+     * Per event base bandwidth shaping of static file downloads.
+     *
+     * --static_rate_limits lists path prefix rules, the longest matching
+     * prefix applies:
+     *
+     *     /updates/=2048:51200,/iso/=512
+     *
+     * caps each connection's downloads below /updates/ at 2048 KB/s and all
+     * of them in the process together at 51200 KB/s; /iso/ downloads get
+     * 512 KB/s per connection. --static_conn_rate_kbps caps downloads no
+     * rule matches. Connection buckets belong to the connection's worker;
+     * the route buckets of a config version are shared by all workers.
+     *
+     * Both come from the running ServerConfig; a reload applies to
+     * downloads started after it, with full route buckets.
+     *
+     * The handler asks for tokens before it reads a block, not before it
+     * sends: a shaped download holds about one block in memory instead of
+     * reading ahead and pacing from buffers.
+     */
+    class BandwidthShaper
+    {
+    public:
+        using Clock = TokenBucket::Clock;
+
+        // Connection, rule index (-1: no rule) and rate of a bucket
+        using ConnKey = std::tuple<const void *, int, double>;
+
+        // Limits applying to one download
+        class Shaping
+        {
+        public:
+            ~Shaping();
+
+            // Largest read that fits a burst
+            size_t maxBlock() const { return maxBlock_; }
+
+            // Zero if n bytes may be read now, else the time to wait
+            Clock::duration acquire(size_t n);
+
+        private:
+            friend class BandwidthShaper;
+
+            BandwidthShaper *shaper_{nullptr};
+            ConnKey connKey_;
+            std::shared_ptr<TokenBucket> conn_;
+            std::shared_ptr<SharedTokenBucket> route_;
+            size_t maxBlock_{0};
+        };
+
+        BandwidthShaper();
+        ~BandwidthShaper();
+
+        static BandwidthShaper &get(folly::EventBase &evb);
+
+        // Shaping of a download of path on connection conn, nullptr if no
+        // limit applies. routeKbps replaces --static_conn_rate_kbps for a
+        // path no rule matches when non-zero.
+        std::unique_ptr<Shaping> shape(const void *conn,
+                                       folly::StringPiece path,
+                                       uint64_t routeKbps = 0);
+
+    private:
+        struct Rule
+        {
+            std::string prefix;
+            double connRate;
+            double routeRate;
+            std::shared_ptr<SharedTokenBucket> route;
+        };
+        using Rules = std::vector<Rule>;
+
+        // Rules of a config version, parsed by the first worker to see it
+        static std::shared_ptr<const Rules> rulesFor(uint64_t version, folly::StringPiece spec);
+
+        static Rules parseRules(folly::StringPiece spec);
+
+        // From the config version the rules were parsed from; downloads
+        // keep the buckets of the version they started under
+        std::shared_ptr<const Rules> rules_;
+        uint64_t rulesVersion_{0};
+        // Buckets shared by the downloads of one connection under one limit
+        std::map<ConnKey, std::weak_ptr<TokenBucket>> conns_;
+
+        struct Stats
+        {
+            WorkerCounter shaped;
+            WorkerCounter delayed;
+        };
+        Stats stats_;
+        uint64_t statsId_{0};
+    };
+
+} // namespace quic::samples
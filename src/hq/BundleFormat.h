@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <folly/Range.h>
+#include <folly/hash/SpookyHashV2.h>
+
+/*
+ * On-disk layout of an asset bundle, shared by the asset_packer tool that
+ * writes it and AssetBundle that serves it. Integers are in host byte order:
+ * a bundle is built for the architecture that serves it.
+ *
+ *   BundleHeader
+ *   uint32_t buckets[numBuckets]   displacement seed of each bucket
+ *   uint32_t slots[numSlots]       entry index, kEmptySlot if unused
+ *   BundleEntry entries[count]
+ *   char strings[stringsSize]      paths, types and ETags, not terminated
+ *   data                           asset bytes, starting page aligned
+ *
+ * Paths are looked up with a hash-and-displace perfect hash: the bucket is
+ * chosen by bundleHash(path, 0), the slot by bundleHash(path, seed of the
+ * bucket). Every slot holds at most one path, so a lookup costs two hashes
+ * and one string compare.
+ */
+namespace quic::samples
+{
+    constexpr char kBundleMagic[8] = {'P', 'X', 'B', 'N', 'D', 'L', '0', '1'};
+    constexpr uint32_t kBundleVersion = 2;
+    constexpr uint32_t kEmptySlot = UINT32_MAX;
+
+    // Variants in ContentCoding order: identity, br, zstd, gzip
+    constexpr size_t kBundleVariants = 4;
+    constexpr const char *kBundleVariantSuffixes[kBundleVariants] = {"", ".br", ".zst", ".gz"};
+
+    struct BundleHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t count;
+        uint32_t numBuckets;
+        uint32_t numSlots;
+        uint64_t stringsSize;
+        uint64_t dataOffset;
+    };
+
+    // Strings are relative to the string table, data spans are absolute
+    // file offsets. A variant with offset 0 is absent. Each variant carries
+    // the ETag of its own bytes, as the manifest computes it for the same
+    // file under the static root.
+    struct BundleSpan
+    {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    struct BundleEntry
+    {
+        BundleSpan path;
+        BundleSpan type;
+        int64_t mtime;
+        BundleSpan variants[kBundleVariants];
+        BundleSpan etags[kBundleVariants];
+    };
+
+    inline uint32_t bundleHash(folly::StringPiece key, uint32_t seed)
+    {
+        return static_cast<uint32_t>(
+            folly::hash::SpookyHashV2::Hash64(key.data(), key.size(), seed));
+    }
+
+    inline uint64_t bucketsOffset()
+    {
+        return sizeof(BundleHeader);
+    }
+
+    inline uint64_t slotsOffset(const BundleHeader &header)
+    {
+        return bucketsOffset() + uint64_t(header.numBuckets) * sizeof(uint32_t);
+    }
+
+    inline uint64_t entriesOffset(const BundleHeader &header)
+    {
+        // Keeps the entries 8 byte aligned
+        uint64_t end = slotsOffset(header) + uint64_t(header.numSlots) * sizeof(uint32_t);
+        return (end + 7) & ~uint64_t(7);
+    }
+
+    inline uint64_t stringsOffset(const BundleHeader &header)
+    {
+        return entriesOffset(header) + uint64_t(header.count) * sizeof(BundleEntry);
+    }
+
+} // namespace quic::samples
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "DynamicCompression.h"
+
+#include <sys/resource.h>
+
+#include <folly/Conv.h>
+#include <folly/String.h>
+#include <folly/io/async/EventBaseLocal.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+#include <proxygen/lib/utils/ZlibStreamCompressor.h>
+#include <proxygen/lib/utils/ZstdStreamCompressor.h>
+
+DEFINE_bool(static_compress,
+            true,
+            "Compress static files without a precompressed sidecar on the fly");
+DEFINE_string(static_compress_types,
+              "html,htm,css,js,mjs,json,map,svg,txt,xml,wasm",
+              "Comma separated extensions eligible for on-the-fly compression");
+DEFINE_uint64(static_compress_min_bytes,
+              256,
+              "Smaller static files are always sent uncompressed");
+DEFINE_uint64(static_compress_max_kb,
+              8192,
+              "Larger static files are never compressed on the fly, in KB");
+DEFINE_uint64(static_compress_cache_mb,
+              32,
+              "Per worker memory budget of compressed results in MB");
+
+namespace
+{
+    constexpr auto kLoadPeriod = std::chrono::seconds(1);
+
+    struct Level
+    {
+        double maxLoad;
+        int zstd;
+        int gzip;
+    };
+    // First row whose load bound is not exceeded wins
+    constexpr Level kLevels[] = {
+        {0.5, 9, 6},
+        {0.8, 3, 4},
+        {1.0, 1, 1},
+    };
+
+    std::chrono::microseconds threadCpuTime()
+    {
+        struct rusage usage{};
+        ::getrusage(RUSAGE_THREAD, &usage);
+        auto tv = [](const timeval &t)
+        { return std::chrono::seconds(t.tv_sec) + std::chrono::microseconds(t.tv_usec); };
+        return tv(usage.ru_utime) + tv(usage.ru_stime);
+    }
+}
+
+namespace quic::samples
+{
+    DynamicCompression::DynamicCompression()
+        : results_("compressed_cache",
+                   FLAGS_static_compress_cache_mb << 20,
+                   FLAGS_static_compress_max_kb << 10),
+          sampleTime_(Clock::now()),
+          sampleCpu_(threadCpuTime())
+    {
+        std::vector<std::string> types;
+        folly::split(',', FLAGS_static_compress_types, types, true);
+        for (auto &type : types)
+        {
+            types_.insert(folly::trimWhitespace(type).str());
+        }
+        statsId_ = StatsRegistry::get().addSource(
+            [this](StatsRegistry::Emit emit)
+            {
+                emit("dynamic_compression.streams", stats_.streams.get());
+                emit("dynamic_compression.bytes_in", stats_.bytesIn.get());
+                emit("dynamic_compression.bytes_out", stats_.bytesOut.get());
+                emit("dynamic_compression.level", stats_.level.get());
+            });
+    }
+
+    DynamicCompression::~DynamicCompression()
+    {
+        StatsRegistry::get().removeSource(statsId_);
+    }
+
+    DynamicCompression &DynamicCompression::get(folly::EventBase &evb)
+    {
+        static folly::EventBaseLocal<std::unique_ptr<DynamicCompression>> instances;
+        auto &instance = instances.try_emplace_with(
+            evb, [] { return std::make_unique<DynamicCompression>(); });
+        return *instance;
+    }
+
+    ContentCoding DynamicCompression::choose(const std::vector<ContentCoding> &accepted,
+                                             folly::StringPiece path,
+                                             uint64_t size) const
+    {
+        if (!FLAGS_static_compress || size < FLAGS_static_compress_min_bytes ||
+            size > (FLAGS_static_compress_max_kb << 10))
+        {
+            return ContentCoding::Identity;
+        }
+        auto slash = path.rfind('/');
+        auto name = slash == folly::StringPiece::npos ? path : path.subpiece(slash + 1);
+        auto dot = name.rfind('.');
+        if (dot == folly::StringPiece::npos ||
+            !types_.count(folly::toLowerAscii(name.subpiece(dot + 1).str())))
+        {
+            return ContentCoding::Identity;
+        }
+        for (auto coding : accepted)
+        {
+            // No brotli encoder is linked in: br is only served from sidecars
+            if (coding == ContentCoding::Zstd || coding == ContentCoding::Gzip)
+            {
+                return coding;
+            }
+        }
+        return ContentCoding::Identity;
+    }
+
+    std::unique_ptr<proxygen::StreamCompressor> DynamicCompression::makeCompressor(
+        ContentCoding coding)
+    {
+        auto current = load();
+        const Level *level = &kLevels[0];
+        while (current > level->maxLoad && level + 1 < std::end(kLevels))
+        {
+            ++level;
+        }
+        stats_.streams.add();
+        if (coding == ContentCoding::Zstd)
+        {
+            stats_.level.set(level->zstd);
+            return std::make_unique<proxygen::ZstdStreamCompressor>(level->zstd);
+        }
+        DCHECK(coding == ContentCoding::Gzip);
+        stats_.level.set(level->gzip);
+        return std::make_unique<proxygen::ZlibStreamCompressor>(
+            proxygen::CompressionType::GZIP, level->gzip);
+    }
+
+    std::string DynamicCompression::resultKey(const std::string &filepath, ContentCoding coding)
+    {
+        return folly::to<std::string>(filepath, "#", codingName(coding));
+    }
+
+    void DynamicCompression::onStreamDone(uint64_t bytesIn, uint64_t bytesOut)
+    {
+        stats_.bytesIn.add(bytesIn);
+        stats_.bytesOut.add(bytesOut);
+    }
+
+    double DynamicCompression::load()
+    {
+        auto now = Clock::now();
+        if (now - sampleTime_ >= kLoadPeriod)
+        {
+            auto cpu = threadCpuTime();
+            load_ = std::chrono::duration<double>(cpu - sampleCpu_).count() /
+                    std::chrono::duration<double>(now - sampleTime_).count();
+            sampleTime_ = now;
+            sampleCpu_ = cpu;
+        }
+        return load_;
+    }
+
+} // namespace quic::samples
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <folly/Range.h>
+#include <folly/io/async/EventBase.h>
+#include <proxygen/lib/utils/StreamCompressor.h>
+
+#include "ObjectCache.h"
+#include "ServerStats.h"
+#include "StaticFileHttp.h"
+
+namespace quic::samples
+{
+    /*
+     * On-the-fly compression of static files that have no precompressed
+     * sidecar, one instance per event base.
+     *
+     * Encoded bodies are kept in a dedicated ObjectCache keyed by path and
+     * coding and versioned by the variant ETag, so each version of an asset
+     * is compressed at most once per worker while it stays cached.
+     *
+     * The compression level follows the CPU load of the worker thread:
+     * while the thread is mostly idle new streams get a high level, a busy
+     * thread falls back to the cheapest one.
+     */
+    class DynamicCompression
+    {
+    public:
+        DynamicCompression();
+        ~DynamicCompression();
+
+        static DynamicCompression &get(folly::EventBase &evb);
+
+        /*
+         * Picks the coding to encode path with among the accepted ones, or
+         * Identity if the type is not on the allowlist, the size is out of
+         * bounds or no supported coding is accepted.
+         */
+        ContentCoding choose(const std::vector<ContentCoding> &accepted,
+                             folly::StringPiece path,
+                             uint64_t size) const;
+
+        // A new encoder at the level matching the current load
+        std::unique_ptr<proxygen::StreamCompressor> makeCompressor(ContentCoding coding);
+
+        ObjectCache &results() { return results_; }
+
+        static std::string resultKey(const std::string &filepath, ContentCoding coding);
+
+        void onStreamDone(uint64_t bytesIn, uint64_t bytesOut);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        // Fraction of wall time the thread spent on CPU over the last period
+        double load();
+
+        ObjectCache results_;
+        std::unordered_set<std::string> types_;
+        double load_{0};
+        Clock::time_point sampleTime_;
+        std::chrono::microseconds sampleCpu_{0};
+
+        struct Stats
+        {
+            WorkerCounter streams;
+            WorkerCounter bytesIn;
+            WorkerCounter bytesOut;
+            WorkerCounter level;
+        };
+        Stats stats_;
+        uint64_t statsId_{0};
+    };
+
+} // namespace quic::samples
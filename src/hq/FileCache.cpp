@@ -0,0 +1,466 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "FileCache.h"
+
+#include <fcntl.h>
+#include <linux/openat2.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/sysmacros.h>
+
+#include <algorithm>
+
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/Format.h>
+#include <folly/io/async/EventBaseLocal.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+
+#include "FileIoSqe.h"
+#include "MimeTypes.h"
+#include "StaticFileHttp.h"
+#include "StaticManifest.h"
+
+DEFINE_uint32(static_file_cache_entries,
+              4096,
+              "Max open files cached per worker for the static handler. "
+              "0 disables the cache.");
+DEFINE_uint32(static_file_negative_ttl_ms,
+              1000,
+              "How long a static file found missing is answered from the "
+              "cache without another open. 0 disables negative caching.");
+DEFINE_bool(static_file_mmap,
+            false,
+            "Serve hot static files as slices of a read-only mapping instead "
+            "of reading them. Files must be replaced by rename, never "
+            "truncated in place, or readers of a mapping fault.");
+DEFINE_uint32(static_file_mmap_hits,
+              8,
+              "Cache hits after which a file counts as hot and is mapped");
+DEFINE_uint64(static_file_mmap_max_mb,
+              64,
+              "Larger static files are never mapped, in MB");
+DEFINE_bool(static_file_odirect,
+            false,
+            "Read large static files with O_DIRECT through the aligned "
+            "buffer pool instead of the page cache");
+DEFINE_uint64(static_file_odirect_min_kb,
+              1024,
+              "Files at least this large (KB) are read with O_DIRECT when "
+              "--static_file_odirect is set");
+
+namespace
+{
+    // Any of these on the watched inode means the cached fd or metadata no
+    // longer matches what the path resolves to.
+    constexpr uint32_t kWatchMask = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+                                    IN_MOVE_SELF | IN_DELETE_SELF;
+
+    // Mappings up to this size are prefaulted, they are served whole
+    constexpr size_t kPopulateMax = 64 << 10;
+    // Up to this size the whole file is worth reading ahead
+    constexpr size_t kWillNeedMax = 16 << 20;
+
+    void unmap(void *addr, void *size)
+    {
+        ::munmap(addr, reinterpret_cast<size_t>(size));
+    }
+
+    std::string fdPath(int fd)
+    {
+        return folly::to<std::string>("/proc/self/fd/", fd);
+    }
+
+    struct stat toStat(const struct statx &stx)
+    {
+        struct stat st{};
+        st.st_dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+        st.st_ino = stx.stx_ino;
+        st.st_mode = stx.stx_mode;
+        st.st_nlink = stx.stx_nlink;
+        st.st_uid = stx.stx_uid;
+        st.st_gid = stx.stx_gid;
+        st.st_size = stx.stx_size;
+        st.st_blksize = stx.stx_blksize;
+        st.st_blocks = stx.stx_blocks;
+        st.st_atim = {stx.stx_atime.tv_sec, stx.stx_atime.tv_nsec};
+        st.st_mtim = {stx.stx_mtime.tv_sec, stx.stx_mtime.tv_nsec};
+        st.st_ctim = {stx.stx_ctime.tv_sec, stx.stx_ctime.tv_nsec};
+        return st;
+    }
+}
+
+namespace quic::samples
+{
+    CachedFile::~CachedFile()
+    {
+        if (fixed_ && backend_)
+        {
+            backend_->unregisterFd(fixed_);
+        }
+    }
+
+    int CachedFile::fixedIndex() const
+    {
+        return fixed_ ? fixed_->idx_ : -1;
+    }
+
+    FileCache::FileCache(folly::EventBase *evb, size_t maxEntries)
+        : evb_(evb),
+          entries_(std::max<size_t>(maxEntries, 1)),
+          negative_(std::max<size_t>(maxEntries, 1))
+    {
+        backend_ = dynamic_cast<folly::IoUringBackend *>(evb_->getBackend());
+        int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0)
+        {
+            PLOG(ERROR) << "inotify_init1 failed, static file cache disabled";
+        }
+        else
+        {
+            inotify_ = folly::File(fd, true);
+            initHandler(evb_, folly::NetworkSocket::fromFd(fd));
+            registerInternalHandler(folly::EventHandler::READ |
+                                    folly::EventHandler::PERSIST);
+        }
+        entries_.setPruneHook(
+            [this](std::string key, std::shared_ptr<CachedFile> &&entry)
+            { dropWatch(key, entry->wd_); });
+    }
+
+    FileCache::~FileCache()
+    {
+        if (inotify_)
+        {
+            unregisterHandler();
+        }
+    }
+
+    FileCache &FileCache::get(folly::EventBase &evb)
+    {
+        static folly::EventBaseLocal<std::unique_ptr<FileCache>> caches;
+        auto &cache = caches.try_emplace_with(
+            evb,
+            [&evb]
+            {
+                return std::make_unique<FileCache>(
+                    &evb, FLAGS_static_file_cache_entries);
+            });
+        return *cache;
+    }
+
+    std::shared_ptr<const CachedFile> FileCache::lookup(
+        const std::string &filepath)
+    {
+        auto it = entries_.find(filepath);
+        if (it == entries_.end())
+        {
+            return nullptr;
+        }
+        auto &entry = *it->second;
+        if (entry.unindexedPath_)
+        {
+            auto generation = StaticManifest::generation();
+            if (generation != entry.manifestGeneration_)
+            {
+                auto indexed = StaticManifest::lookup(*entry.unindexedPath_);
+                if (indexed && indexed->matches(entry.stat))
+                {
+                    // Reopened with the manifest's ETag
+                    invalidate(filepath);
+                    return nullptr;
+                }
+                entry.manifestGeneration_ = generation;
+            }
+        }
+        if (FLAGS_static_file_mmap && !entry.mapping_ &&
+            ++entry.hits_ == FLAGS_static_file_mmap_hits)
+        {
+            map(entry);
+        }
+        return it->second;
+    }
+
+    void FileCache::map(CachedFile &entry)
+    {
+        size_t size = entry.stat.st_size;
+        if (size == 0 || size > (FLAGS_static_file_mmap_max_mb << 20))
+        {
+            return;
+        }
+        // Small files are faulted in up front so serving never blocks on a
+        // page fault; larger ones get read-ahead hints by size class
+        int flags = MAP_SHARED | (size <= kPopulateMax ? MAP_POPULATE : 0);
+        void *addr = ::mmap(nullptr, size, PROT_READ, flags, entry.file.fd(), 0);
+        if (addr == MAP_FAILED)
+        {
+            PLOG(WARNING) << "mmap of a static file failed, reading it instead";
+            return;
+        }
+        if (size > kPopulateMax)
+        {
+            ::madvise(addr, size, size <= kWillNeedMax ? MADV_WILLNEED : MADV_SEQUENTIAL);
+        }
+        entry.mapping_ = folly::IOBuf::takeOwnership(
+            addr, size, size, unmap, reinterpret_cast<void *>(size));
+    }
+
+    int FileCache::rootFd(const std::string &staticRoot)
+    {
+        auto it = rootDirs_.find(staticRoot);
+        if (it == rootDirs_.end())
+        {
+            int fd = ::open(staticRoot.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                return -errno;
+            }
+            it = rootDirs_.emplace(staticRoot, folly::File(fd, true)).first;
+        }
+        return it->second.fd();
+    }
+
+    void FileCache::openAsync(const std::string &filepath,
+                              const std::string &staticRoot,
+                              folly::StringPiece path,
+                              OpenCallback cb)
+    {
+        auto missing = negative_.findWithoutPromotion(filepath);
+        if (missing != negative_.end())
+        {
+            if (std::chrono::steady_clock::now() < missing->second)
+            {
+                cb(nullptr, -ENOENT);
+                return;
+            }
+            negative_.erase(missing);
+        }
+        auto &waiters = pending_[filepath];
+        waiters.push_back(std::move(cb));
+        if (waiters.size() > 1)
+        {
+            return;
+        }
+        int dirfd = backend_ ? rootFd(staticRoot) : -ENOTSUP;
+        if (dirfd < 0)
+        {
+            completeOpen(filepath, nullptr, dirfd);
+            return;
+        }
+        while (path.startsWith('/'))
+        {
+            path.advance(1);
+        }
+        auto *open = new OpenAt2IoSqe(
+            dirfd,
+            path.empty() ? "." : path.str(),
+            O_RDONLY | O_CLOEXEC,
+            RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS,
+            [this, filepath, rel = path.str()](int fd)
+            {
+                if (fd < 0)
+                {
+                    completeOpen(filepath, nullptr, fd);
+                    return;
+                }
+                auto *statx = new StatxIoSqe(
+                    fd,
+                    STATX_BASIC_STATS,
+                    [this, filepath, rel, file = folly::File(fd, true)](
+                        int res, const struct statx &stx) mutable
+                    {
+                        if (res < 0)
+                        {
+                            completeOpen(filepath, nullptr, res);
+                            return;
+                        }
+                        if (!S_ISREG(stx.stx_mode))
+                        {
+                            completeOpen(filepath, nullptr, -EISDIR);
+                            return;
+                        }
+                        completeOpen(filepath,
+                                     publish(filepath, rel, std::move(file), toStat(stx)),
+                                     0);
+                    });
+                backend_->submitSoon(*statx);
+            });
+        backend_->submitSoon(*open);
+    }
+
+    void FileCache::completeOpen(const std::string &filepath,
+                                 std::shared_ptr<const CachedFile> entry,
+                                 int err)
+    {
+        auto it = pending_.find(filepath);
+        if (it == pending_.end())
+        {
+            return;
+        }
+        auto waiters = std::move(it->second);
+        pending_.erase(it);
+        if ((err == -ENOENT || err == -ENOTDIR) && FLAGS_static_file_negative_ttl_ms > 0)
+        {
+            negative_.set(filepath,
+                          std::chrono::steady_clock::now() +
+                              std::chrono::milliseconds(FLAGS_static_file_negative_ttl_ms));
+        }
+        for (auto &cb : waiters)
+        {
+            cb(entry, err);
+        }
+    }
+
+    std::shared_ptr<CachedFile> FileCache::publish(const std::string &filepath,
+                                                   folly::StringPiece path,
+                                                   folly::File file,
+                                                   const struct stat &st)
+    {
+        auto entry = std::make_shared<CachedFile>();
+        entry->file = std::move(file);
+        entry->stat = st;
+        // Read before the lookup: a build published in between is seen
+        // again on the next lookup()
+        auto generation = StaticManifest::generation();
+        auto indexed = StaticManifest::lookup(path);
+        if (indexed && indexed->matches(st))
+        {
+            entry->etag = std::move(indexed->etag);
+            entry->contentType = std::string(indexed->contentType);
+        }
+        else
+        {
+            // Not indexed yet, or changed since: fall back to a validator
+            // that still changes with the file
+            entry->etag = folly::sformat("\"{}-{:x}\"",
+                                         entry->stat.st_size,
+                                         (long long)entry->stat.st_mtime);
+            entry->contentType =
+                std::string(mimeTypeFor(std::string_view(path.data(), path.size())));
+            entry->unindexedPath_ = path.str();
+            entry->manifestGeneration_ = generation;
+        }
+        entry->lastModified = formatHttpDate(entry->stat.st_mtime);
+        if (FLAGS_static_file_odirect &&
+            uint64_t(entry->stat.st_size) >= (FLAGS_static_file_odirect_min_kb << 10))
+        {
+            // Reopening through procfs reaches the same inode without
+            // another path walk
+            int fd = ::open(fdPath(entry->file.fd()).c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+            if (fd >= 0)
+            {
+                entry->directFile = folly::File(fd, true);
+            }
+            else
+            {
+                // e.g. tmpfs does not support O_DIRECT
+                PLOG(WARNING) << "O_DIRECT open failed, using the page cache: "
+                              << filepath;
+            }
+        }
+
+        // Drop any previous entry first: the new watch may share its wd
+        invalidate(filepath);
+        if (FLAGS_static_file_cache_entries == 0 || !addWatch(*entry))
+        {
+            // Without a watch we could not tell when the entry goes stale
+            return entry;
+        }
+        if (backend_)
+        {
+            entry->backend_ = backend_;
+            entry->fixed_ = backend_->registerFd(entry->readFd());
+        }
+        watches_[entry->wd_].push_back(filepath);
+        entries_.set(filepath, entry);
+        return entry;
+    }
+
+    void FileCache::invalidate(const std::string &filepath)
+    {
+        auto it = entries_.findWithoutPromotion(filepath);
+        if (it == entries_.end())
+        {
+            return;
+        }
+        auto wd = it->second->wd_;
+        entries_.erase(filepath);
+        dropWatch(filepath, wd);
+    }
+
+    bool FileCache::addWatch(CachedFile &entry)
+    {
+        if (!inotify_)
+        {
+            return false;
+        }
+        // Watch the open inode rather than walking the path again
+        auto path = fdPath(entry.file.fd());
+        int wd = ::inotify_add_watch(inotify_.fd(), path.c_str(), kWatchMask);
+        if (wd < 0)
+        {
+            PLOG(WARNING) << "inotify_add_watch failed, not caching: " << path;
+            return false;
+        }
+        entry.wd_ = wd;
+        return true;
+    }
+
+    void FileCache::dropWatch(const std::string &filepath, int wd)
+    {
+        auto it = watches_.find(wd);
+        if (it == watches_.end())
+        {
+            return;
+        }
+        auto &keys = it->second;
+        keys.erase(std::remove(keys.begin(), keys.end(), filepath), keys.end());
+        if (keys.empty())
+        {
+            ::inotify_rm_watch(inotify_.fd(), wd);
+            watches_.erase(it);
+        }
+    }
+
+    void FileCache::handlerReady(uint16_t /*events*/) noexcept
+    {
+        alignas(struct inotify_event) char buf[4096];
+        for (;;)
+        {
+            auto len = folly::readNoInt(inotify_.fd(), buf, sizeof(buf));
+            if (len <= 0)
+            {
+                break;
+            }
+            for (char *p = buf; p < buf + len;)
+            {
+                auto *ev = reinterpret_cast<struct inotify_event *>(p);
+                p += sizeof(struct inotify_event) + ev->len;
+                auto it = watches_.find(ev->wd);
+                if (it == watches_.end())
+                {
+                    continue;
+                }
+                auto keys = std::move(it->second);
+                watches_.erase(it);
+                if (!(ev->mask & IN_IGNORED))
+                {
+                    ::inotify_rm_watch(inotify_.fd(), ev->wd);
+                }
+                for (auto &key : keys)
+                {
+                    VLOG(4) << "Invalidating cached file: " << key;
+                    entries_.erase(key);
+                }
+            }
+        }
+    }
+
+} // namespace quic::samples
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/File.h>
+#include <folly/Function.h>
+#include <folly/Range.h>
+#include <folly/container/EvictingCacheMap.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventHandler.h>
+#include <folly/io/async/IoUringBackend.h>
+
+namespace quic::samples
+{
+    /*
+     * An open static file together with the metadata needed to answer a
+     * request for it. Entries are immutable once published; the cache drops
+     * its reference on eviction or invalidation while in-flight requests keep
+     * theirs until they are done with the descriptor.
+     */
+    struct CachedFile
+    {
+        CachedFile() = default;
+        CachedFile(const CachedFile &) = delete;
+        CachedFile &operator=(const CachedFile &) = delete;
+        ~CachedFile();
+
+        // Slot of readFd() in the ring's fixed file table, -1 if not registered
+        int fixedIndex() const;
+
+        // Reads bypass the page cache through an O_DIRECT descriptor
+        bool directIo() const { return bool(directFile); }
+
+        int readFd() const { return directIo() ? directFile.fd() : file.fd(); }
+
+        // A slice of the whole-file mapping, or nullptr if not mapped
+        std::unique_ptr<folly::IOBuf> mapped() const
+        {
+            return mapping_ ? mapping_->cloneOne() : nullptr;
+        }
+
+        folly::File file;
+        folly::File directFile;
+        struct stat stat{};
+        // Where the content starts in file, non-zero for bundle members
+        off_t offset{0};
+        std::string etag;
+        std::string lastModified;
+        // Empty when unknown
+        std::string contentType;
+
+    private:
+        friend class AssetBundle;
+        friend class FileCache;
+        folly::IoUringBackend *backend_{nullptr};
+        folly::IoUringFdRegistrationRecord *fixed_{nullptr};
+        int wd_{-1};
+        uint32_t hits_{0};
+        // Set while etag is the size-mtime fallback: the root relative path
+        // and the manifest generation it was missing from
+        std::optional<std::string> unindexedPath_;
+        uint64_t manifestGeneration_{0};
+        // Read-only mapping, shared by refcount with every slice handed out;
+        // munmap runs when the entry and the last slice are gone
+        std::unique_ptr<folly::IOBuf> mapping_;
+    };
+
+    /*
+     * Per event base cache of open descriptors and their stat/ETag/
+     * Last-Modified/Content-Type results, keyed by the requested file path.
+     * ETags come from the StaticManifest when it has indexed the file.
+     *
+     * The cache is shared-nothing: every worker owns its own instance and
+     * only touches it from its event base thread. It is bounded in entries
+     * and evicts in LRU order. Each cached file carries an inotify watch so
+     * that any modification, attribute/link change, move or removal drops
+     * the entry before the next request can observe stale metadata.
+     */
+    class FileCache : private folly::EventHandler
+    {
+    public:
+        FileCache(folly::EventBase *evb, size_t maxEntries);
+        ~FileCache() override;
+
+        // Returns the cache of the given event base, creating it on first use
+        static FileCache &get(folly::EventBase &evb);
+
+        // Returns the cached entry for the path or nullptr on a miss. With
+        // --static_file_mmap an entry is mapped once it turned hot. An entry
+        // with a fallback ETag is dropped once a newer manifest indexes the
+        // file, so every worker ends up sending the content hash.
+        std::shared_ptr<const CachedFile> lookup(const std::string &filepath);
+
+        // Gets the entry, or a negative errno if the file can't be served
+        using OpenCallback =
+            folly::Function<void(std::shared_ptr<const CachedFile>, int)>;
+
+        /*
+         * Opens and stats the request path below staticRoot through an
+         * io_uring OPENAT2 -> STATX chain, caches the result under filepath
+         * and hands it to cb, so a cold lookup never blocks the event base.
+         * The kernel confines the lookup to the root (RESOLVE_BENEATH).
+         * Concurrent opens of the same key share one chain. Paths found
+         * missing are remembered for --static_file_negative_ttl_ms so probes
+         * for optional files, like precompressed sidecars, stay cheap.
+         * cb may run before this returns.
+         */
+        void openAsync(const std::string &filepath,
+                       const std::string &staticRoot,
+                       folly::StringPiece path,
+                       OpenCallback cb);
+
+        void invalidate(const std::string &filepath);
+
+        size_t size() const { return entries_.size(); }
+
+    private:
+        using EntryMap =
+            folly::EvictingCacheMap<std::string, std::shared_ptr<CachedFile>>;
+        // Expiry of each path known not to exist
+        using NegativeMap =
+            folly::EvictingCacheMap<std::string, std::chrono::steady_clock::time_point>;
+
+        void handlerReady(uint16_t events) noexcept override;
+
+        int rootFd(const std::string &staticRoot);
+
+        // path is relative to the static root
+        std::shared_ptr<CachedFile> publish(const std::string &filepath,
+                                            folly::StringPiece path,
+                                            folly::File file,
+                                            const struct stat &st);
+
+        void completeOpen(const std::string &filepath,
+                          std::shared_ptr<const CachedFile> entry,
+                          int err);
+
+        void map(CachedFile &entry);
+
+        bool addWatch(CachedFile &entry);
+        void dropWatch(const std::string &filepath, int wd);
+
+        folly::EventBase *evb_;
+        folly::IoUringBackend *backend_{nullptr};
+        folly::File inotify_;
+        EntryMap entries_;
+        NegativeMap negative_;
+        std::unordered_map<int, std::vector<std::string>> watches_;
+        std::unordered_map<std::string, std::vector<OpenCallback>> pending_;
+        // O_PATH fds of every root served so far. Never closed while the
+        // cache lives: queued opens refer to them by number.
+        std::unordered_map<std::string, folly::File> rootDirs_;
+    };
+
+} // namespace quic::samples
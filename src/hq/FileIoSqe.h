@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <linux/openat2.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <folly/Function.h>
+#include <folly/IntrusiveList.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/IoUringBackend.h>
+
+namespace quic::samples
+{
+    // Told when a read it dispatched has left the ring, completed or not
+    class ReadDoneObserver
+    {
+    public:
+        virtual void onReadDone() noexcept = 0;
+
+    protected:
+        ~ReadDoneObserver() = default;
+    };
+
+    /*
+     * A single file read submitted straight to the io_uring backend.
+     * Unlike IoUringBackend::queueRead it can address a file through its
+     * fixed-file slot, which spares the kernel the fd table lookup, and read
+     * into a registered buffer with IORING_OP_READ_FIXED.
+     * Completions of several reads may arrive in any order.
+     *
+     * The object owns itself and the buffer the kernel writes into, and is
+     * deleted once its completion ran, so the buffer can't be freed while
+     * the read is still in flight. The issuer links the read into its list
+     * through hook; the hook unlinks itself on deletion. An issuer that goes
+     * away first calls detach() and cancels the read with
+     * IoUringBackend::cancel(); the buffer is freed when the kernel is done.
+     */
+    class FileReadIoSqe : public folly::IoSqeBase
+    {
+    public:
+        using Callback = folly::Function<void(std::unique_ptr<folly::IOBuf>, int)>;
+
+        // Reads len bytes at offset into the start of buf's buffer. buf's
+        // data pointer may sit past it; it is handed back as is.
+        FileReadIoSqe(int fd,
+                      int fixedIdx,
+                      std::unique_ptr<folly::IOBuf> buf,
+                      size_t len,
+                      off_t offset,
+                      Callback cb,
+                      int bufIndex = -1)
+            : IoSqeBase(IoSqeBase::Type::Read),
+              fd_(fd),
+              fixedIdx_(fixedIdx),
+              bufIndex_(bufIndex),
+              buf_(std::move(buf)),
+              len_(len),
+              offset_(offset),
+              cb_(std::move(cb))
+        {
+        }
+
+        // Punt the read to an io-wq worker instead of trying it inline, so
+        // many reads can be outstanding on the device at once
+        void setAsync(bool async) { async_ = async; }
+
+        // The issuer is gone: complete silently
+        void detach() { cb_ = nullptr; }
+
+        size_t length() const { return len_; }
+
+        void setObserver(ReadDoneObserver *observer) { observer_ = observer; }
+
+        void processSubmit(struct io_uring_sqe *sqe) noexcept override
+        {
+            int fd = fixedIdx_ >= 0 ? fixedIdx_ : fd_;
+            auto *data = buf_->writableBuffer();
+            if (bufIndex_ >= 0)
+            {
+                ::io_uring_prep_read_fixed(sqe, fd, data, len_, offset_, bufIndex_);
+            }
+            else
+            {
+                ::io_uring_prep_read(sqe, fd, data, len_, offset_);
+            }
+            if (fixedIdx_ >= 0)
+            {
+                sqe->flags |= IOSQE_FIXED_FILE;
+            }
+            if (async_)
+            {
+                sqe->flags |= IOSQE_ASYNC;
+            }
+        }
+
+        void callback(const io_uring_cqe *cqe) noexcept override
+        {
+            auto cb = std::move(cb_);
+            auto buf = std::move(buf_);
+            auto res = cqe->res;
+            auto *observer = observer_;
+            delete this;
+            if (observer)
+            {
+                observer->onReadDone();
+            }
+            if (cb)
+            {
+                cb(std::move(buf), res);
+            }
+        }
+
+        void callbackCancelled(const io_uring_cqe * /*cqe*/) noexcept override
+        {
+            auto *observer = observer_;
+            delete this;
+            if (observer)
+            {
+                observer->onReadDone();
+            }
+        }
+
+        folly::IntrusiveListHook hook;
+
+    private:
+        int fd_;
+        int fixedIdx_;
+        int bufIndex_;
+        bool async_{false};
+        std::unique_ptr<folly::IOBuf> buf_;
+        size_t len_;
+        off_t offset_;
+        Callback cb_;
+        ReadDoneObserver *observer_{nullptr};
+    };
+
+    using FileReadList = folly::IntrusiveList<FileReadIoSqe, &FileReadIoSqe::hook>;
+
+    /*
+     * IORING_OP_OPENAT2 of a path relative to a directory fd. The resolve
+     * flags let the kernel confine the lookup, e.g. RESOLVE_BENEATH.
+     * The callback gets the new fd or a negative errno; a descriptor opened
+     * after the callback was dropped is closed.
+     */
+    class OpenAt2IoSqe : public folly::IoSqeBase
+    {
+    public:
+        using Callback = folly::Function<void(int)>;
+
+        OpenAt2IoSqe(int dirfd, std::string path, uint64_t flags, uint64_t resolve, Callback cb)
+            : dirfd_(dirfd), path_(std::move(path)), cb_(std::move(cb))
+        {
+            how_.flags = flags;
+            how_.resolve = resolve;
+        }
+
+        void processSubmit(struct io_uring_sqe *sqe) noexcept override
+        {
+            ::io_uring_prep_openat2(sqe, dirfd_, path_.c_str(), &how_);
+        }
+
+        void callback(const io_uring_cqe *cqe) noexcept override
+        {
+            auto cb = std::move(cb_);
+            auto res = cqe->res;
+            delete this;
+            if (cb)
+            {
+                cb(res);
+            }
+            else if (res >= 0)
+            {
+                ::close(res);
+            }
+        }
+
+        void callbackCancelled(const io_uring_cqe *cqe) noexcept override
+        {
+            if (cqe && cqe->res >= 0)
+            {
+                ::close(cqe->res);
+            }
+            delete this;
+        }
+
+    private:
+        int dirfd_;
+        std::string path_;
+        struct open_how how_{};
+        Callback cb_;
+    };
+
+    /*
+     * IORING_OP_STATX of an open descriptor (AT_EMPTY_PATH).
+     * The callback gets 0 or a negative errno and the result.
+     */
+    class StatxIoSqe : public folly::IoSqeBase
+    {
+    public:
+        using Callback = folly::Function<void(int, const struct statx &)>;
+
+        StatxIoSqe(int fd, unsigned mask, Callback cb)
+            : fd_(fd), mask_(mask), cb_(std::move(cb))
+        {
+        }
+
+        void processSubmit(struct io_uring_sqe *sqe) noexcept override
+        {
+            ::io_uring_prep_statx(sqe, fd_, "", AT_EMPTY_PATH, mask_, &stx_);
+        }
+
+        void callback(const io_uring_cqe *cqe) noexcept override
+        {
+            cb_(cqe->res, stx_);
+            delete this;
+        }
+
+        void callbackCancelled(const io_uring_cqe * /*cqe*/) noexcept override
+        {
+            delete this;
+        }
+
+    private:
+        int fd_;
+        unsigned mask_;
+        struct statx stx_{};
+        Callback cb_;
+    };
+
+} // namespace quic::samples
@@ -1,165 +1,397 @@
 #include <sys/eventfd.h>
+#include <map>
 #include <numeric>
+#include <optional>
 
 #include <folly/FileUtil.h>
 #include <folly/Function.h>
 #include <folly/String.h>
+#include <folly/io/async/AsyncTimeout.h>
 #include <folly/io/async/EventHandler.h>
+#include <folly/io/IOBufQueue.h>
 #include <folly/io/async/IoUringBackend.h>
+#include <proxygen/lib/http/HTTPPriorityFunctions.h>
 #include <algorithm>
 
+#include "AlignedBufferPool.h"
+#include "AssetBundle.h"
+#include "BandwidthShaper.h"
+#include "DynamicCompression.h"
+#include "FileCache.h"
+#include "FileIoSqe.h"
+#include "HandlerPool.h"
+#include "IOBufPool.h"
+#include "IoScheduler.h"
+#include "MimeTypes.h"
+#include "ObjectCache.h"
+#include "PriorityScheduler.h"
+#include "ReadCoalescer.h"
+#include "ReadWindow.h"
+#include "ResponseHeaders.h"
 #include "SampleHandlers.h"
+#include "StaticFileHttp.h"
 
-namespace
+namespace quic::samples
 {
-    class AlignedBuf
+    class StaticFileUringHandler : public BaseSampleHandler,
+                                   public PooledHandler<StaticFileUringHandler>
     {
     public:
-        static constexpr size_t kAlign = 4096;
-        AlignedBuf() = delete;
-
-        AlignedBuf(size_t count, char ch) : size_(count)
+        // sidecars: serve foo.br/.zst/.gz in place of foo when the client
+        // accepts the coding and the file exists
+        StaticFileUringHandler(const HandlerParams &params, std::string staticRoot, bool sidecars)
+            : BaseSampleHandler(params), staticRoot_(std::move(staticRoot)), sidecars_(sidecars)
         {
-            ::posix_memalign(&data_, kAlign, size_);
-            // CHECK(!!data_);
-            //::memset(data_, ch, count);
         }
 
-        AlignedBuf(const AlignedBuf &buf) : size_(buf.size_)
+        ~StaticFileUringHandler() override
         {
-            if (size_)
+            // The stream went away with reads outstanding: stop them from
+            // calling back and ask the kernel to drop them. Each read frees
+            // its buffer when its completion arrives.
+            if (evb_)
+            {
+                auto &scheduler = IoScheduler::get(*evb_);
+                while (!reads_.empty())
+                {
+                    auto &sqe = reads_.front();
+                    reads_.pop_front();
+                    sqe.detach();
+                    scheduler.cancel(this, &sqe);
+                }
+                scheduler.removeFlow(this);
+            }
+            if (inflight_ > 0)
             {
-                ::posix_memalign(&data_, kAlign, size_);
-                CHECK(!!data_);
-                ::memcpy(data_, buf.data_, size_);
+                ReadBudget::get(*evb_).release(inflight_);
             }
+            leave_scheduler();
         }
 
-        ~AlignedBuf()
+        // Completions may arrive in any order: blocks are parked in reorder_
+        // and sent once everything before them has been sent.
+        void read_callback(off_t at, size_t len, std::unique_ptr<folly::IOBuf> buf, int res)
         {
-            if (data_)
+            //VLOG(1) << "read_callback res:" << res << " at:" << at << " offset:" << offset_;
+            --req_send;
+            if (res > 0)
             {
-                ::free(data_);
+                window_->onReadComplete(res);
+            }
+            if (res < 0)
+            {
+                LOG(ERROR) << "Read of '" << filepath_ << "' at " << at
+                           << " failed: " << folly::errnoStr(-res);
+                txn_->sendAbort();
+                return;
+            }
+            if (res == 0)
+            {
+                // EOF before the promised length: the file was truncated
+                LOG(ERROR) << "Short read of '" << filepath_ << "' at " << at
+                           << ": 0/" << len;
+                txn_->sendAbort();
+                return;
             }
+            buf->append(res);
+            if (static_cast<size_t>(res) < len)
+            {
+                // A short read is not EOF, fetch the rest of the block
+                submit_read(at + res, len - res);
+            }
+            reorder_.emplace(at, std::move(buf));
+            send_ready();
         }
 
-        AlignedBuf &operator=(const AlignedBuf &buf)
+        void send_ready()
         {
-            if (data_)
+            while (!reorder_.empty() && reorder_.begin()->first == offset_)
+            {
+                auto buf = std::move(reorder_.begin()->second);
+                reorder_.erase(reorder_.begin());
+                size_t len = buf->length();
+                offset_ += len;
+                inflight_ -= len;
+                ReadBudget::get(*evb_).release(len);
+                if (!send_body(std::move(buf)))
+                {
+                    return;
+                }
+            }
+            if (offset_ == end_)
+            {
+                if (compressor_)
+                {
+                    // Flush the encoder and write the end of the frame
+                    if (!send_body(folly::IOBuf::create(0), true))
+                    {
+                        return;
+                    }
+                    DynamicCompression::get(*evb_).onStreamDone(end_, encodedBytes_);
+                    compressor_.reset();
+                }
+                if (filling_)
+                {
+                    fillCache_->insert(fillKey_, headers_->etag, fill_.move());
+                    filling_ = false;
+                }
+                ++segIdx_;
+                start_segment();
+            }
+            else
             {
-                ::free(data_);
+                queue_read();
             }
+        }
 
-            size_ = buf.size_;
-            if (size_)
+        // Sends file bytes, through the encoder when compressing on the fly.
+        // Returns false if the stream had to be aborted.
+        bool send_body(std::unique_ptr<folly::IOBuf> buf, bool last = false)
+        {
+            if (compressor_)
+            {
+                buf = compressor_->compress(buf.get(), last);
+                if (compressor_->hasError())
+                {
+                    LOG(ERROR) << "Compressing '" << filepath_ << "' failed";
+                    txn_->sendAbort();
+                    return false;
+                }
+                if (!buf || buf->empty())
+                {
+                    return true;
+                }
+                encodedBytes_ += buf->computeChainDataLength();
+            }
+            if (filling_)
             {
-                ::posix_memalign(&data_, kAlign, size_);
-                CHECK(!!data_);
-                ::memcpy(data_, buf.data_, size_);
+                fill_.append(buf->clone());
             }
+            txn_->sendBody(std::move(buf));
+            return true;
+        }
 
-            return *this;
+        void queue_read()
+        {
+            if (paused_)
+            {
+                return;
+            }
+            window_->update(*txn_);
+            auto &scheduler = PriorityScheduler::get(*evb_);
+            if (auto priority = txn_->getHTTPPriority())
+            {
+                // Picks up PRIORITY_UPDATE frames
+                PriorityScheduler::Priority current{priority->urgency, priority->incremental};
+                if (!(current == priority_))
+                {
+                    priority_ = current;
+                    scheduler.update(conn_, priorityId_, priority_);
+                }
+            }
+            size_t window = scheduler.allowance(
+                conn_, priorityId_, window_->windowBytes(), window_->blockSize());
+            auto &budget = ReadBudget::get(*evb_);
+            size_t directSize = file_->directIo() ? AlignedBufferPool::get(*evb_).bufferSize() : 0;
+            size_t grid = directSize ? 0 : ReadCoalescer::grid();
+            // Bytes parked in reorder_ count against the window until sent
+            while (req_offset_ < end_ && inflight_ < window)
+            {
+                size_t len = directSize
+                                 ? directSize - (req_offset_ - AlignedBufferPool::alignDown(req_offset_))
+                             : grid ? grid - req_offset_ % grid
+                                    : window_->blockSize();
+                len = std::min<off_t>(len, end_ - req_offset_);
+                if (shaping_)
+                {
+                    len = std::min(len, shaping_->maxBlock());
+                }
+                if (!budget.reserve(len, inflight_ == 0))
+                {
+                    // Completions of our own reads bring us back here
+                    break;
+                }
+                if (shaping_ && !acquire_tokens(len))
+                {
+                    budget.release(len);
+                    break;
+                }
+                submit_read(req_offset_, len);
+                req_offset_ += len;
+                inflight_ += len;
+            }
+            //VLOG(1) << "queue_read";
         }
 
-        bool operator==(const AlignedBuf &buf) const
+        // Takes len bytes from the rate limits, or arms the timer that calls
+        // queue_read again once they hold enough
+        bool acquire_tokens(size_t len)
         {
-            if (size_ != buf.size_)
+            if (shapingTimer_ && shapingTimer_->isScheduled())
             {
                 return false;
             }
-
-            if (size_ == 0)
+            auto wait = shaping_->acquire(len);
+            if (wait == BandwidthShaper::Clock::duration::zero())
             {
                 return true;
             }
-
-            return (0 == ::memcmp(data_, buf.data_, size_));
+            if (!shapingTimer_)
+            {
+                shapingTimer_ = folly::AsyncTimeout::make(*evb_, [this]() noexcept { queue_read(); });
+            }
+            // Round up: waking early only re-arms the timer
+            auto ms = std::chrono::ceil<std::chrono::milliseconds>(wait);
+            shapingTimer_->scheduleTimeout(ms);
+            return false;
         }
 
-        bool operator!=(const AlignedBuf &buf) const { return !(*this == buf); }
-
-        void *data() const { return data_; }
-
-        size_t size() const { return size_; }
-
-    private:
-        void *data_{nullptr};
-        size_t size_{0};
-    };
-}
-
-static std::string formatTimestamp(time_t time)
-{
-  tm tm;
-#ifdef _WIN32
-  gmtime_s(&tm, &time);
-#else
-  gmtime_r(&time, &tm);
-#endif
-  char buf[32];
-  strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
-  return buf;
-}
+        // Reads [at, at + len) of the content, which is already accounted
+        // for in inflight_. Bundle members start at file_->offset.
+        void submit_read(off_t at, size_t len)
+        {
+            if (file_->directIo())
+            {
+                submit_direct_read(at, len);
+                return;
+            }
+            FileReadIoSqe::Callback readCb =
+                [this, at, len](std::unique_ptr<folly::IOBuf> buf, int res)
+            {
+                read_callback(at, len, std::move(buf), res);
+            };
+            if (ReadCoalescer::grid())
+            {
+                // The read may be shared with other requests, so it can't be
+                // cancelled with this one: a late completion is dropped
+                ReadCoalescer::get(*evb_).read(
+                    file_,
+                    file_->offset + at,
+                    len,
+                    window_->asyncReads(),
+                    [alive = std::weak_ptr<bool>(alive_), readCb = std::move(readCb)](
+                        std::unique_ptr<folly::IOBuf> buf, int res) mutable
+                    {
+                        if (!alive.expired())
+                        {
+                            readCb(std::move(buf), res);
+                        }
+                    });
+                ++req_send;
+                return;
+            }
+            auto *sqe = new FileReadIoSqe(file_->readFd(),
+                                          file_->fixedIndex(),
+                                          IOBufPool::get(*evb_).acquire(len),
+                                          len,
+                                          file_->offset + at,
+                                          std::move(readCb));
+            submit(sqe);
+        }
 
-namespace quic::samples
-{
-    class StaticFileUringHandler : public BaseSampleHandler
-    {
-        static constexpr size_t kNumBlocks = 32;
-        static constexpr size_t kBlockSize = 4096;
+        // O_DIRECT needs the offset, length and buffer 4K aligned, so the
+        // read covers the aligned span around the wanted bytes and the IOBuf
+        // is trimmed to them afterwards. The span fits one pool buffer.
+        void submit_direct_read(off_t at, size_t len)
+        {
+            // Only whole files are opened with O_DIRECT
+            DCHECK_EQ(file_->offset, 0);
+            auto &pool = AlignedBufferPool::get(*evb_);
+            size_t aligned = AlignedBufferPool::alignDown(at);
+            size_t head = at - aligned;
+            size_t readLen = AlignedBufferPool::alignUp(head + len);
+            DCHECK_LE(readLen, pool.bufferSize());
+            int bufIndex = -1;
+            auto buf = pool.acquire(bufIndex);
+            buf->advance(head);
+            FileReadIoSqe::Callback readCb =
+                [this, at, head, len](std::unique_ptr<folly::IOBuf> buf, int res)
+            {
+                // The tail of the file may come back unaligned
+                int got = res < 0 ? res
+                                  : static_cast<int>(std::min<size_t>(
+                                        std::max<int>(res - static_cast<int>(head), 0), len));
+                read_callback(at, len, std::move(buf), got);
+            };
+            auto *sqe = new FileReadIoSqe(file_->readFd(),
+                                          file_->fixedIndex(),
+                                          std::move(buf),
+                                          readLen,
+                                          aligned,
+                                          std::move(readCb),
+                                          bufIndex);
+            submit(sqe);
+        }
 
-    public:
-        StaticFileUringHandler(const HandlerParams &params, std::string staticRoot)
-            : BaseSampleHandler(params), staticRoot_(std::move(staticRoot))
+        void submit(FileReadIoSqe *sqe)
         {
+            sqe->setAsync(window_->asyncReads());
+            reads_.push_back(*sqe);
+            // Queued behind other transactions' reads when the worker is busy
+            IoScheduler::get(*evb_).submit(this, file_->stat.st_size, sqe);
+            ++req_send;
         }
 
-        void read_callback(off_t at, int idx, int res)
+        // Sends part headers up to the next range that needs disk reads and
+        // starts reading it; finishes the response after the last range.
+        void start_segment()
         {
-            //VLOG(1) << "read_callback res:" << res << " at:" << at << " offset:" << offset_ << " beg:" << idx;
-            if (res < 0)
+            while (segIdx_ < segments_.size())
             {
-                txn_->sendAbort();
-                return;
+                auto &seg = segments_[segIdx_];
+                if (seg.prefix)
+                {
+                    txn_->sendBody(std::move(seg.prefix));
+                }
+                if (seg.begin < seg.end)
+                {
+                    offset_ = req_offset_ = seg.begin;
+                    end_ = seg.end;
+                    queue_read();
+                    return;
+                }
+                ++segIdx_;
             }
-            //buf.postallocate(res);
-            readVec[idx]->append(res);
-            txn_->sendBody(std::move(readVec[idx]));
-            assert(offset_ == at);//should be equal, if not there is reorder
-            offset_ += res;
-            if (res != kBlockSize)
+            if (trailer_)
             {
-                txn_->sendEOM();
+                txn_->sendBody(std::move(trailer_));
             }
-            else
+            txn_->sendEOM();
+            leave_scheduler();
+        }
+
+        void leave_scheduler()
+        {
+            if (priorityId_)
             {
-                if (--req_send <= 0)
-                {
-                    queue_read();
-                }
+                PriorityScheduler::get(*evb_).remove(conn_, priorityId_);
+                priorityId_ = 0;
             }
         }
 
-        void queue_read()
+        // Serves all segments as slices of a body from the object cache or of
+        // a file mapping
+        void send_cached(std::unique_ptr<folly::IOBuf> body)
         {
-            if (paused_)
+            for (auto &seg : segments_)
             {
-                return;
+                if (seg.prefix)
+                {
+                    txn_->sendBody(std::move(seg.prefix));
+                }
+                if (seg.begin < seg.end)
+                {
+                    auto slice = body->cloneOne();
+                    slice->trimStart(seg.begin);
+                    slice->trimEnd(slice->length() - (seg.end - seg.begin));
+                    txn_->sendBody(std::move(slice));
+                }
             }
-            uint64_t blocks_count = std::min(((stat.st_size - req_offset_) / kBlockSize) + 1, kNumBlocks);
-            //auto data = buf.preallocate(kBlockSize * blocks_count, kBlockSize * blocks_count);
-            uint64_t add_idx{0};
-            for (size_t idx = 0; idx < blocks_count; idx++)
-            {
-                folly::IoUringBackend::FileOpCallback readCb = std::bind(&StaticFileUringHandler::read_callback, this, req_offset_, idx, std::placeholders::_1);
-                readVec[idx] = folly::IOBuf::create(kBlockSize);
-                backendPtr->queueRead(
-                    file_->fd(), readVec[idx]->writableData(), kBlockSize, req_offset_, std::move(readCb));
-                req_offset_ += kBlockSize;
-                add_idx += kBlockSize;
-                ++req_send;
+            if (trailer_)
+            {
+                txn_->sendBody(std::move(trailer_));
             }
-            //VLOG(1) << "queue_read";
+            txn_->sendEOM();
         }
 
         void
@@ -173,61 +405,344 @@ namespace quic::samples
                 sendError("Path cannot contain ..");
                 return;
             }
-            std::string safepath{};
-            auto filepath = folly::to<std::string>(staticRoot_, "/", path);
-            try
-            {
-                safepath = proxygen::SafePath::getPath(filepath, staticRoot_, true);
-                file_ = std::make_unique<folly::File>(safepath, O_RDONLY | O_CLOEXEC); // O_DIRECT |
-            }
-            catch (...)
+            path_ = path.str();
+            basePath_ = folly::to<std::string>(staticRoot_, "/", path);
+            evb_ = folly::EventBaseManager::get()->getEventBase();
+            backendPtr = dynamic_cast<folly::IoUringBackend *>(evb_->getBackend());
+            if (!backendPtr)
             {
                 auto errorMsg = folly::to<std::string>(
-                    "Invalid URL: cannot open requested file. "
+                    "FailureInvalid URL: cannot open requested file. "
                     "path: '",
                     path,
                     "'");
-                LOG(ERROR) << errorMsg << " file: '" << filepath << "'";
+                LOG(ERROR) << errorMsg << " file: '" << basePath_ << "'";
                 sendError(errorMsg);
                 return;
             }
-            auto *evbPtr = folly::EventBaseManager::get()->getEventBase();
-            backendPtr = dynamic_cast<folly::IoUringBackend *>(evbPtr->getBackend());
-            if (!backendPtr)
+            if (auto priority = proxygen::httpPriorityFromHTTPMessage(*msg))
             {
-                auto errorMsg = folly::to<std::string>(
-                    "FailureInvalid URL: cannot open requested file. "
-                    "path: '",
-                    path,
-                    "'");
-                LOG(ERROR) << errorMsg << " file: '" << filepath << "'";
-                sendError(errorMsg);
+                priority_ = {priority->urgency, priority->incremental};
+            }
+            auto method = msg->getMethod();
+            if (sidecars_ &&
+                (method == proxygen::HTTPMethod::GET || method == proxygen::HTTPMethod::HEAD))
+            {
+                codings_ = acceptedCodings(
+                    msg->getHeaders().combine(proxygen::HTTP_HEADER_ACCEPT_ENCODING));
+            }
+            if (auto bundle = AssetBundle::current())
+            {
+                // Bundled assets are found without touching the filesystem
+                if (auto file = bundle->find(path_, codings_, coding_))
+                {
+                    file_ = std::move(file);
+                    filepath_ = folly::to<std::string>(basePath_, sidecarSuffix(coding_));
+                    respond(std::move(msg));
+                    return;
+                }
+            }
+            open_next(std::move(msg));
+        }
+
+        // Tries the accepted sidecars in preference order, then the file
+        // itself. Missing sidecars are negatively cached by FileCache.
+        void open_next(std::unique_ptr<proxygen::HTTPMessage> msg)
+        {
+            coding_ = codingIdx_ < codings_.size() ? codings_[codingIdx_++]
+                                                   : ContentCoding::Identity;
+            auto suffix = sidecarSuffix(coding_);
+            filepath_ = folly::to<std::string>(basePath_, suffix);
+            auto &cache = FileCache::get(*evb_);
+            file_ = cache.lookup(filepath_);
+            if (file_)
+            {
+                respond(std::move(msg));
                 return;
             }
-            if (fstat(file_->fd(), &stat) == -1)
+            // Cold path: open and stat on the ring; headers go out once the
+            // chain completed, then the first reads are queued
+            cache.openAsync(
+                filepath_,
+                staticRoot_,
+                folly::to<std::string>(path_, suffix),
+                [this, alive = std::weak_ptr<bool>(alive_), msg = std::move(msg)](
+                    std::shared_ptr<const CachedFile> file, int err) mutable
+                {
+                    if (alive.expired())
+                    {
+                        return;
+                    }
+                    if (!file && coding_ != ContentCoding::Identity)
+                    {
+                        open_next(std::move(msg));
+                        return;
+                    }
+                    if (!file)
+                    {
+                        auto errorMsg = folly::to<std::string>(
+                            "Invalid URL: cannot open requested file. "
+                            "path: '",
+                            path_,
+                            "'");
+                        LOG(ERROR) << errorMsg << " file: '" << filepath_
+                                   << "': " << folly::errnoStr(-err);
+                        sendError(errorMsg);
+                        return;
+                    }
+                    file_ = std::move(file);
+                    respond(std::move(msg));
+                });
+        }
+
+        // A sidecar standing in for its base file has the base file's type;
+        // anything else, foo.gz requested as such included, its own
+        std::string_view content_type() const
+        {
+            if (coding_ != ContentCoding::Identity)
             {
-                auto errorMsg = folly::to<std::string>(
-                    "FailureInvalid URL: cannot open requested file. "
-                    "path: '",
-                    path,
-                    "'");
-                LOG(ERROR) << errorMsg << " file: '" << filepath << "'";
-                sendError(errorMsg);
+                return mimeTypeFor(basePath_);
+            }
+            return file_->contentType;
+        }
+
+        // Formats the headers of the selected representation; runs once per
+        // asset version, coding and length on each worker
+        void build_headers(HeaderTemplate &tmpl, uint64_t length)
+        {
+            tmpl.etag = variantEtag(file_->etag, coding_);
+            auto &validators = tmpl.validators;
+            validators.add(proxygen::HTTP_HEADER_ETAG, tmpl.etag);
+            validators.add(proxygen::HTTP_HEADER_LAST_MODIFIED, file_->lastModified);
+            if (coding_ != ContentCoding::Identity)
+            {
+                validators.add(proxygen::HTTP_HEADER_CONTENT_ENCODING, codingName(coding_));
+            }
+            if (sidecars_ || coding_ != ContentCoding::Identity)
+            {
+                validators.add(proxygen::HTTP_HEADER_VARY, "Accept-Encoding");
+            }
+            if (!params_.altSvc.empty())
+            {
+                validators.add(proxygen::HTTP_HEADER_ALT_SVC, params_.altSvc);
+            }
+            tmpl.full = validators;
+            auto contentType = content_type();
+            if (!contentType.empty())
+            {
+                tmpl.full.add(proxygen::HTTP_HEADER_CONTENT_TYPE, contentType);
+            }
+            if (length != HeaderTemplateCache::kUnknownLength)
+            {
+                tmpl.full.add(proxygen::HTTP_HEADER_CONTENT_LENGTH, folly::to<std::string>(length));
+                tmpl.full.add(proxygen::HTTP_HEADER_ACCEPT_RANGES, "bytes");
+            }
+        }
+
+        // The route's cache policy applies to whatever representation is
+        // served, so it is not part of the templates
+        void add_cache_control(proxygen::HTTPHeaders &headers) const
+        {
+            if (route_ && !route_->cacheControl.empty())
+            {
+                headers.add(proxygen::HTTP_HEADER_CACHE_CONTROL, route_->cacheControl);
+            }
+        }
+
+        void respond(std::unique_ptr<proxygen::HTTPMessage> msg)
+        {
+            uint64_t size = file_->stat.st_size;
+            auto method = msg->getMethod();
+            // No sidecar was found: encode on the fly, or serve a result
+            // encoded for an earlier request
+            std::unique_ptr<folly::IOBuf> encoded;
+            bool streaming = false;
+            auto &dynamic = DynamicCompression::get(*evb_);
+            conn_ = &txn_->getTransport();
+            if (method != proxygen::HTTPMethod::HEAD)
+            {
+                shaping_ = BandwidthShaper::get(*evb_).shape(
+                    conn_, path_, route_ ? route_->rateKbps : 0);
+            }
+            // A shaped download is paced by its disk reads, so it is served
+            // from a file or sidecar: on the fly encoding would hand out
+            // cached results in one burst
+            if (coding_ == ContentCoding::Identity && !codings_.empty() && !shaping_)
+            {
+                coding_ = dynamic.choose(codings_, path_, size);
+                if (coding_ != ContentCoding::Identity)
+                {
+                    encoded = dynamic.results().lookup(
+                        DynamicCompression::resultKey(filepath_, coding_),
+                        variantEtag(file_->etag, coding_));
+                    if (encoded)
+                    {
+                        size = encoded->computeChainDataLength();
+                    }
+                    streaming = !encoded;
+                }
+            }
+            uint64_t length = streaming ? HeaderTemplateCache::kUnknownLength : size;
+            headers_ = HeaderTemplateCache::get(*evb_).lookup(
+                file_,
+                coding_,
+                length,
+                sidecars_,
+                [&](HeaderTemplate &tmpl) { build_headers(tmpl, length); });
+            const auto &etag = headers_->etag;
+            const auto &date = DateHeader::get(*evb_).now();
+            auto precondition = evaluateConditional(
+                method,
+                msg->getHeaders().combine(proxygen::HTTP_HEADER_IF_NONE_MATCH),
+                msg->getHeaders().getSingleOrEmpty(proxygen::HTTP_HEADER_IF_MODIFIED_SINCE),
+                etag,
+                file_->stat.st_mtime);
+            if (precondition != Precondition::Proceed)
+            {
+                // Nothing is read: validators alone answer the request
+                proxygen::HTTPMessage resp = precondition == Precondition::NotModified
+                                                 ? createHttpResponse(304, "Not Modified")
+                                                 : createHttpResponse(412, "Precondition Failed");
+                resp.getHeaders() = headers_->validators;
+                resp.getHeaders().add(proxygen::HTTP_HEADER_DATE, date);
+                add_cache_control(resp.getHeaders());
+                txn_->sendHeaders(resp);
+                txn_->sendEOM();
                 return;
             }
+            std::vector<ByteRange> ranges;
+            auto rangeResult = RangeResult::None;
+            const auto &range = msg->getHeaders().getSingleOrEmpty(proxygen::HTTP_HEADER_RANGE);
+            // The encoded length is unknown while streaming, so Range is
+            // ignored, which RFC 9110 allows
+            if (!range.empty() && method == proxygen::HTTPMethod::GET && !streaming)
+            {
+                const auto &ifRange = msg->getHeaders().getSingleOrEmpty(proxygen::HTTP_HEADER_IF_RANGE);
+                if (ifRange.empty() || ifRangeMatches(ifRange, etag, file_->lastModified))
+                {
+                    rangeResult = parseRangeHeader(range, size, ranges);
+                }
+            }
 
-            proxygen::HTTPMessage resp = createHttpResponse(200, "Ok");
-            maybeAddAltSvcHeader(resp);
+            if (rangeResult == RangeResult::Unsatisfiable)
+            {
+                proxygen::HTTPMessage resp = createHttpResponse(416, "Range Not Satisfiable");
+                maybeAddAltSvcHeader(resp);
+                auto &headers{resp.getHeaders()};
+                headers.add(proxygen::HTTP_HEADER_DATE, date);
+                headers.add(proxygen::HTTP_HEADER_CONTENT_RANGE, folly::to<std::string>("bytes */", size));
+                headers.add(proxygen::HTTP_HEADER_CONTENT_LENGTH, "0");
+                txn_->sendHeaders(resp);
+                txn_->sendEOM();
+                return;
+            }
+
+            proxygen::HTTPMessage resp = rangeResult == RangeResult::Satisfiable
+                                             ? createHttpResponse(206, "Partial Content")
+                                             : createHttpResponse(200, "Ok");
             auto& headers{resp.getHeaders()};
-            headers.add(proxygen::HTTP_HEADER_CONTENT_LENGTH, std::to_string(stat.st_size));
-            headers.add(proxygen::HTTP_HEADER_ETAG,  folly::sformat("\"{}-{:x}\"", stat.st_size, (long long)stat.st_mtime));
-            headers.add(proxygen::HTTP_HEADER_LAST_MODIFIED, formatTimestamp(stat.st_mtime));
-            headers.add(proxygen::HTTP_HEADER_ACCEPT_RANGES, "bytes");
-            
-            
-           ;
+            uint64_t contentLength = size;
+            auto contentType = content_type();
+            if (rangeResult == RangeResult::None)
+            {
+                // The common case is served entirely from the template
+                headers = headers_->full;
+                segments_.push_back(Segment{nullptr, 0, static_cast<off_t>(size)});
+            }
+            else if (ranges.size() == 1)
+            {
+                headers = headers_->validators;
+                headers.add(proxygen::HTTP_HEADER_CONTENT_RANGE, formatContentRange(ranges[0], size));
+                segments_.push_back(Segment{nullptr,
+                                            static_cast<off_t>(ranges[0].first),
+                                            static_cast<off_t>(ranges[0].last + 1)});
+                contentLength = ranges[0].length();
+                if (!contentType.empty())
+                {
+                    headers.add(proxygen::HTTP_HEADER_CONTENT_TYPE, contentType);
+                }
+            }
+            else
+            {
+                headers = headers_->validators;
+                auto boundary = folly::sformat("{:016x}", folly::Random::rand64());
+                contentLength = 0;
+                for (const auto &r : ranges)
+                {
+                    auto prefix = folly::IOBuf::copyBuffer(folly::to<std::string>(
+                        "\r\n--", boundary, "\r\n",
+                        contentType.empty() ? "" : "Content-Type: ",
+                        contentType,
+                        contentType.empty() ? "" : "\r\n",
+                        "Content-Range: ", formatContentRange(r, size), "\r\n\r\n"));
+                    contentLength += prefix->length() + r.length();
+                    segments_.push_back(Segment{std::move(prefix),
+                                                static_cast<off_t>(r.first),
+                                                static_cast<off_t>(r.last + 1)});
+                }
+                trailer_ = folly::IOBuf::copyBuffer(folly::to<std::string>("\r\n--", boundary, "--\r\n"));
+                contentLength += trailer_->length();
+                headers.add(proxygen::HTTP_HEADER_CONTENT_TYPE,
+                            folly::to<std::string>("multipart/byteranges; boundary=", boundary));
+            }
+            if (rangeResult == RangeResult::Satisfiable)
+            {
+                headers.add(proxygen::HTTP_HEADER_CONTENT_LENGTH, folly::to<std::string>(contentLength));
+                headers.add(proxygen::HTTP_HEADER_ACCEPT_RANGES, "bytes");
+            }
+            headers.add(proxygen::HTTP_HEADER_DATE, date);
+            add_cache_control(headers);
             txn_->sendHeaders(resp);
-            queue_read();
+            if (method == proxygen::HTTPMethod::HEAD)
+            {
+                txn_->sendEOM();
+                return;
+            }
+
+            if (encoded)
+            {
+                send_cached(std::move(encoded));
+                return;
+            }
+            if (streaming)
+            {
+                // Keep the encoded output so the next request is a hit
+                compressor_ = dynamic.makeCompressor(coding_);
+                filling_ = true;
+                fillCache_ = &dynamic.results();
+                fillKey_ = DynamicCompression::resultKey(filepath_, coding_);
+            }
+            else if (shaping_)
+            {
+                // Read at the target rate instead of sending from memory
+            }
+            else if (auto slice = file_->mapped())
+            {
+                // Hot file: the slices reference the mapping, nothing is read
+                // or copied until QUIC packetizes them
+                send_cached(std::move(slice));
+                return;
+            }
+            else
+            {
+                auto &bodies = ObjectCache::get(*evb_);
+                if (bodies.fits(size))
+                {
+                    if (auto body = bodies.lookup(filepath_, headers_->etag))
+                    {
+                        send_cached(std::move(body));
+                        return;
+                    }
+                    // Miss: keep clones of what we send and cache the full body
+                    filling_ = rangeResult == RangeResult::None;
+                    fillCache_ = &bodies;
+                    fillKey_ = filepath_;
+                }
+            }
+            window_.emplace(contentLength);
+            // Only streams that read from disk compete for read-ahead
+            priorityId_ = PriorityScheduler::get(*evb_).add(conn_, priority_);
+            start_segment();
             // albuf = std::make_unique<AlignedBuf>()
             // int fd = folly::fileops::open(tempFile.path().c_str(), O_DIRECT | O_RDWR);
             // fd_ = folly::fileops::open(tempFile.path().c_str(), O_DIRECT | O_RDONLY | O_CLOEXEC);
@@ -260,15 +775,28 @@ namespace quic::samples
         {
             VLOG(10) << "StaticFileUringHandler::onEgressPaused";
             paused_ = true;
+            if (window_)
+            {
+                window_->onEgressPaused();
+            }
         }
 
         void onEgressResumed() noexcept override
         {
             VLOG(10) << "StaticFileUringHandler::onEgressResumed";
+            if (window_)
+            {
+                window_->onEgressResumed();
+            }
             if (paused_)
             {
                 paused_ = false;
-                queue_read();
+                // Nothing to read before the file is open or when served
+                // from the object cache
+                if (window_ && segIdx_ < segments_.size())
+                {
+                    queue_read();
+                }
             }
             // folly::getUnsafeMutableGlobalCPUExecutor()->add(
             //     std::bind(&StaticFileUringHandler::readFile,
@@ -331,16 +859,63 @@ namespace quic::samples
             txn_->sendEOM();
         }
 
+        struct Segment
+        {
+            // multipart part header sent ahead of the range bytes
+            std::unique_ptr<folly::IOBuf> prefix;
+            off_t begin;
+            off_t end;
+        };
+
         // std::unique_ptr<AlignedBuf> albuf;
-        struct stat stat{};
-        std::array<std::unique_ptr<folly::IOBuf>,kNumBlocks> readVec{};
-        std::unique_ptr<folly::File> file_;
+        std::shared_ptr<const CachedFile> file_;
+        // Open completions check it to tell whether the handler still exists
+        std::shared_ptr<bool> alive_{std::make_shared<bool>(true)};
+        std::vector<Segment> segments_;
+        size_t segIdx_{0};
+        std::unique_ptr<folly::IOBuf> trailer_;
+        // Cache key of the file being served: basePath_ plus sidecar suffix
+        std::string filepath_;
+        std::string basePath_;
+        // Request path below staticRoot_
+        std::string path_;
+        std::vector<ContentCoding> codings_;
+        size_t codingIdx_{0};
+        ContentCoding coding_{ContentCoding::Identity};
+        // Prebuilt headers of the selected representation, holds its ETag
+        std::shared_ptr<const HeaderTemplate> headers_;
+        folly::EventBase *evb_{nullptr};
+        folly::IOBufQueue fill_{folly::IOBufQueue::cacheChainLength()};
+        bool filling_{false};
+        ObjectCache *fillCache_{nullptr};
+        std::string fillKey_;
+        // Set while encoding the body on the fly
+        std::unique_ptr<proxygen::StreamCompressor> compressor_;
+        uint64_t encodedBytes_{0};
         std::atomic<bool> paused_{false};
         std::string staticRoot_;
+        bool sidecars_;
         folly::IoUringBackend *backendPtr{nullptr};
+        std::optional<ReadWindow> window_;
+        // RFC 9218 priority from the request, then from PRIORITY_UPDATE
+        PriorityScheduler::Priority priority_;
+        // Registration with the connection's PriorityScheduler, 0 if none
+        const void *conn_{nullptr};
+        uint64_t priorityId_{0};
+        // Rate limits of this download, nullptr if unshaped; the timer
+        // resumes reading once the limits allow it
+        std::unique_ptr<BandwidthShaper::Shaping> shaping_;
+        std::unique_ptr<folly::AsyncTimeout> shapingTimer_;
+        // File bytes submitted and not yet sent
+        size_t inflight_{0};
+        // Completed blocks waiting for the bytes before them, by file offset
+        std::map<off_t, std::unique_ptr<folly::IOBuf>> reorder_;
+        // Reads submitted and not completed yet, cancelled on teardown
+        FileReadList reads_;
         int req_send {0};
         off_t offset_{0};
         off_t req_offset_{0};
+        off_t end_{0};
         //folly::IOBufQueue buf;
     };
 
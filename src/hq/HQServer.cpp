@@ -11,11 +11,13 @@
 #include <ostream>
 #include <quic/common/udpsocket/FollyQuicAsyncUDPSocket.h>
 #include <string>
+#include <type_traits>
 
 #include <folly/io/async/EventBaseLocal.h>
 #include "FizzContext.h"
 #include "H1QDownstreamSession.h"
 #include "HQLoggerHelper.h"
+#include "ServerConfig.h"
 #include <proxygen/lib/http/session/HQDownstreamSession.h>
 #include <quic/server/QuicSharedUDPSocketFactory.h>
 
@@ -259,6 +261,42 @@ HQServer::HQServer(HQServerParams params,
   server_->setHealthCheckToken("health");
   server_->setSupportedVersion(params_.quicVersions);
   server_->setFizzContext(createFizzServerContext(params_));
+  // Transport knobs of the running config apply to each new connection;
+  // established ones keep what they negotiated
+  server_->setTransportSettingsOverrideFn(
+      [](const quic::TransportSettings& settings, const folly::IPAddress&) {
+        using Result = std::invoke_result_t<
+            quic::QuicServer::TransportSettingsOverrideFn,
+            const quic::TransportSettings&,
+            const folly::IPAddress&>;
+        auto config = ConfigStore::current();
+        const auto& transport = config->transport;
+        if (!transport.connFlowControlWindow &&
+            !transport.streamFlowControlWindow && !transport.maxBidiStreams &&
+            !transport.idleTimeout) {
+          return Result();
+        }
+        auto overridden = settings;
+        if (transport.connFlowControlWindow) {
+          overridden.advertisedInitialConnectionFlowControlWindow =
+              *transport.connFlowControlWindow;
+        }
+        if (transport.streamFlowControlWindow) {
+          overridden.advertisedInitialBidiLocalStreamFlowControlWindow =
+              *transport.streamFlowControlWindow;
+          overridden.advertisedInitialBidiRemoteStreamFlowControlWindow =
+              *transport.streamFlowControlWindow;
+          overridden.advertisedInitialUniStreamFlowControlWindow =
+              *transport.streamFlowControlWindow;
+        }
+        if (transport.maxBidiStreams) {
+          overridden.advertisedInitialMaxStreamsBidi = *transport.maxBidiStreams;
+        }
+        if (transport.idleTimeout) {
+          overridden.idleTimeout = *transport.idleTimeout;
+        }
+        return Result(std::move(overridden));
+      });
   if (params_.rateLimitPerThread) {
     server_->setRateLimit(
         [rateLimitPerThread = params_.rateLimitPerThread.value()]() {
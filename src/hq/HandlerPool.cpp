@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "HandlerPool.h"
+
+#include <algorithm>
+#include <new>
+
+#include <folly/Conv.h>
+#include <glog/logging.h>
+
+namespace quic::samples
+{
+    SlabPool::SlabPool(std::string name, size_t objectSize, size_t alignment)
+        : name_(std::move(name)),
+          // Room for the freelist link, and every object stays aligned
+          objectSize_((std::max(objectSize, sizeof(FreeNode)) + alignment - 1) / alignment *
+                      alignment),
+          alignment_(alignment),
+          owner_(std::this_thread::get_id())
+    {
+        statsId_ = StatsRegistry::get().addSource(
+            [this, prefix = folly::to<std::string>("handler_pool.", name_, ".")](
+                StatsRegistry::Emit emit)
+            {
+                emit(prefix + "allocs", stats_.allocs.get());
+                emit(prefix + "slab_allocs", stats_.slabAllocs.get());
+                emit(prefix + "live", stats_.live.get());
+                emit(prefix + "fallbacks", stats_.fallbacks.get());
+            });
+    }
+
+    SlabPool::~SlabPool()
+    {
+        StatsRegistry::get().removeSource(statsId_);
+        if (live_ > 0)
+        {
+            // Objects outlived their thread: leave their memory alone
+            LOG(WARNING) << live_ << " " << name_ << " objects alive at thread exit";
+            return;
+        }
+        for (auto *slab : slabs_)
+        {
+            ::operator delete(slab, std::align_val_t(alignment_));
+        }
+    }
+
+    void SlabPool::grow()
+    {
+        auto *slab = static_cast<char *>(
+            ::operator new(objectSize_ * kObjectsPerSlab, std::align_val_t(alignment_)));
+        slabs_.push_back(slab);
+        stats_.slabAllocs.add();
+        // Thread the new objects onto the freelist in address order
+        for (size_t i = kObjectsPerSlab; i > 0; --i)
+        {
+            auto *node = reinterpret_cast<FreeNode *>(slab + (i - 1) * objectSize_);
+            node->next = free_;
+            free_ = node;
+        }
+    }
+
+    void *SlabPool::allocate()
+    {
+        DCHECK(std::this_thread::get_id() == owner_);
+        if (!free_)
+        {
+            grow();
+        }
+        auto *node = free_;
+        free_ = node->next;
+        ++live_;
+        stats_.allocs.add();
+        stats_.live.set(live_);
+        return node;
+    }
+
+    void SlabPool::deallocate(void *p)
+    {
+        DCHECK(std::this_thread::get_id() == owner_) << name_ << " freed on another thread";
+        auto *node = static_cast<FreeNode *>(p);
+        node->next = free_;
+        free_ = node;
+        --live_;
+        stats_.live.set(live_);
+    }
+
+} // namespace quic::samples
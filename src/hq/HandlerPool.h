@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <folly/lang/Pretty.h>
+
+#include "ServerStats.h"
+
+namespace quic::samples
+{
+    /*
+     * Thread local slab allocator of objects of one size.
+     *
+     * Objects are carved from slabs of kObjectsPerSlab and recycled through
+     * an intrusive freelist, so after warm-up allocating one is a pointer
+     * pop. Slabs are kept for the life of the thread. An object must be
+     * freed on the thread that allocated it, which holds for handlers: a
+     * transaction is created and detached on its session's event base.
+     */
+    class SlabPool
+    {
+    public:
+        static constexpr size_t kObjectsPerSlab = 32;
+
+        SlabPool(std::string name, size_t objectSize, size_t alignment);
+        ~SlabPool();
+
+        SlabPool(const SlabPool &) = delete;
+        SlabPool &operator=(const SlabPool &) = delete;
+
+        void *allocate();
+        void deallocate(void *p);
+
+        // Counts a request the pool could not serve, see PooledHandler
+        void onFallback() { stats_.fallbacks.add(); }
+
+    private:
+        struct FreeNode
+        {
+            FreeNode *next;
+        };
+
+        void grow();
+
+        const std::string name_;
+        const size_t objectSize_;
+        const size_t alignment_;
+        const std::thread::id owner_;
+        FreeNode *free_{nullptr};
+        std::vector<void *> slabs_;
+        size_t live_{0};
+
+        struct Stats
+        {
+            WorkerCounter allocs;
+            WorkerCounter slabAllocs;
+            WorkerCounter live;
+            WorkerCounter fallbacks;
+        };
+        Stats stats_;
+        uint64_t statsId_{0};
+    };
+
+    /*
+     * Base giving a handler class operator new/delete backed by a per thread
+     * SlabPool of its type, so `new Handler(...)` and the `delete this` in
+     * BaseSampleHandler::detachTransaction skip the general allocator.
+     *
+     *     class FooHandler : public BaseSampleHandler,
+     *                        public PooledHandler<FooHandler>
+     *
+     * A subclass of T inherits the operators but not the size; its objects
+     * go to the global allocator and are counted as fallbacks.
+     */
+    template <class T>
+    class PooledHandler
+    {
+    public:
+        static void *operator new(size_t size)
+        {
+            if (size != sizeof(T))
+            {
+                pool().onFallback();
+                return ::operator new(size);
+            }
+            return pool().allocate();
+        }
+
+        static void operator delete(void *p, size_t size)
+        {
+            if (size != sizeof(T))
+            {
+                ::operator delete(p);
+                return;
+            }
+            pool().deallocate(p);
+        }
+
+    private:
+        static SlabPool &pool()
+        {
+            static thread_local SlabPool pool(
+                name(), sizeof(T), std::max(alignof(T), alignof(void *)));
+            return pool;
+        }
+
+        // Unqualified type name for the stats
+        static std::string name()
+        {
+            std::string full(folly::pretty_name<T>());
+            auto colon = full.rfind("::");
+            return colon == std::string::npos ? full : full.substr(colon + 2);
+        }
+    };
+
+} // namespace quic::samples
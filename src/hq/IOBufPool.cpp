@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "IOBufPool.h"
+
+#include <cstdlib>
+#include <new>
+
+#include <folly/io/async/EventBaseLocal.h>
+#include <folly/lang/Bits.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+
+DEFINE_uint64(static_file_buffer_pool_mb,
+              64,
+              "Per worker memory kept for recycling file read buffers, in MB. "
+              "0 disables recycling.");
+
+namespace
+{
+    // The free callback's user data is the pool pointer with the size class
+    // in its low bits
+    constexpr uintptr_t kClassMask = 0xf;
+
+    size_t classSize(size_t cls)
+    {
+        return size_t(1) << (quic::samples::IOBufPool::kMinClassShift + cls);
+    }
+}
+
+namespace quic::samples
+{
+    IOBufPool::IOBufPool(size_t maxCachedBytes)
+        : owner_(std::this_thread::get_id()), maxCachedBytes_(maxCachedBytes)
+    {
+        static_assert(alignof(IOBufPool) > kClassMask, "size class is packed in the pool pointer");
+        statsId_ = StatsRegistry::get().addSource(
+            [this](StatsRegistry::Emit emit)
+            {
+                emit("read_buffer_pool.reused", stats_.reused.get());
+                emit("read_buffer_pool.allocated", stats_.allocated.get());
+                emit("read_buffer_pool.remote_frees", stats_.remoteFrees.get());
+                emit("read_buffer_pool.cached_bytes", stats_.cachedBytes.get());
+                emit("read_buffer_pool.in_use", stats_.inUse.get());
+            });
+    }
+
+    IOBufPool::~IOBufPool()
+    {
+        StatsRegistry::get().removeSource(statsId_);
+        drainRemote();
+        for (auto &list : free_)
+        {
+            for (auto *buf : list)
+            {
+                ::free(buf);
+            }
+        }
+    }
+
+    void IOBufPool::Deleter::operator()(IOBufPool *pool) const
+    {
+        pool->detached_.store(true, std::memory_order_release);
+        pool->unref();
+    }
+
+    IOBufPool &IOBufPool::get(folly::EventBase &evb)
+    {
+        static folly::EventBaseLocal<std::unique_ptr<IOBufPool, Deleter>> pools;
+        auto &pool = pools.try_emplace_with(
+            evb,
+            []
+            {
+                return std::unique_ptr<IOBufPool, Deleter>(
+                    new IOBufPool(FLAGS_static_file_buffer_pool_mb << 20));
+            });
+        return *pool;
+    }
+
+    std::unique_ptr<folly::IOBuf> IOBufPool::acquire(size_t size)
+    {
+        size_t cls = folly::findLastSet(std::max<size_t>(size, 1) - 1);
+        cls = cls > kMinClassShift ? cls - kMinClassShift : 0;
+        if (cls >= kNumClasses || maxCachedBytes_ == 0)
+        {
+            return folly::IOBuf::create(size);
+        }
+        auto &list = free_[cls];
+        if (list.empty())
+        {
+            drainRemote();
+        }
+        void *buf;
+        if (!list.empty())
+        {
+            buf = list.back();
+            list.pop_back();
+            cachedBytes_ -= classSize(cls);
+            stats_.cachedBytes.set(cachedBytes_);
+            stats_.reused.add();
+        }
+        else
+        {
+            buf = ::malloc(classSize(cls));
+            if (!buf)
+            {
+                throw std::bad_alloc();
+            }
+            stats_.allocated.add();
+        }
+        refs_.fetch_add(1, std::memory_order_relaxed);
+        stats_.inUse.add();
+        auto tag = reinterpret_cast<uintptr_t>(this) | cls;
+        return folly::IOBuf::takeOwnership(
+            buf, classSize(cls), 0, &IOBufPool::freeBuffer, reinterpret_cast<void *>(tag));
+    }
+
+    void IOBufPool::freeBuffer(void *buf, void *userData)
+    {
+        auto tag = reinterpret_cast<uintptr_t>(userData);
+        auto *pool = reinterpret_cast<IOBufPool *>(tag & ~kClassMask);
+        auto cls = static_cast<uint8_t>(tag & kClassMask);
+        if (std::this_thread::get_id() == pool->owner_)
+        {
+            pool->recycle(buf, cls);
+        }
+        else
+        {
+            pool->releaseRemote(buf, cls);
+        }
+        pool->unref();
+    }
+
+    void IOBufPool::releaseRemote(void *buf, uint8_t cls)
+    {
+        if (!detached_.load(std::memory_order_acquire))
+        {
+            auto size = classSize(cls);
+            if (remoteBytes_.fetch_add(size, std::memory_order_relaxed) + size <= maxCachedBytes_)
+            {
+                auto *node = new (buf) FreeNode;
+                node->cls = cls;
+                remote_.insertHead(node);
+                return;
+            }
+            // The owner is behind on draining
+            remoteBytes_.fetch_sub(size, std::memory_order_relaxed);
+            remoteDropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        ::free(buf);
+    }
+
+    void IOBufPool::recycle(void *buf, uint8_t cls)
+    {
+        stats_.inUse.sub();
+        if (detached_.load(std::memory_order_relaxed) ||
+            cachedBytes_ + classSize(cls) > maxCachedBytes_)
+        {
+            ::free(buf);
+            return;
+        }
+        free_[cls].push_back(buf);
+        cachedBytes_ += classSize(cls);
+        stats_.cachedBytes.set(cachedBytes_);
+    }
+
+    void IOBufPool::drainRemote()
+    {
+        // Buffers other threads freed directly are no longer in use
+        stats_.inUse.sub(remoteDropped_.exchange(0, std::memory_order_relaxed));
+        remote_.sweep(
+            [this](FreeNode *node)
+            {
+                auto cls = node->cls;
+                node->~FreeNode();
+                remoteBytes_.fetch_sub(classSize(cls), std::memory_order_relaxed);
+                stats_.remoteFrees.add();
+                recycle(node, cls);
+            });
+    }
+
+    void IOBufPool::unref()
+    {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete this;
+        }
+    }
+
+} // namespace quic::samples
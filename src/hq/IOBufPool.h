@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <folly/AtomicIntrusiveLinkedList.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+
+#include "ServerStats.h"
+
+namespace quic::samples
+{
+    /*
+     * Per event base pool of read buffers in power of two size classes
+     * from 4K to 1M.
+     *
+     * acquire() wraps a recycled buffer in an IOBuf whose free callback puts
+     * it back. A buffer released on the owning thread goes straight to its
+     * class freelist; one released elsewhere is pushed on a lock-free return
+     * queue that the owner drains when a freelist runs dry. Cached memory,
+     * and separately the bytes waiting on the return queue, are capped by
+     * --static_file_buffer_pool_mb; beyond that buffers are freed where
+     * they are released, so a stalled owner does not accumulate them.
+     *
+     * The pool is refcounted by its event base and its outstanding buffers
+     * and is freed when the last of them lets go.
+     */
+    class alignas(16) IOBufPool
+    {
+    public:
+        static constexpr size_t kMinClassShift = 12;
+        static constexpr size_t kNumClasses = 9;
+
+        explicit IOBufPool(size_t maxCachedBytes);
+        IOBufPool(const IOBufPool &) = delete;
+        IOBufPool &operator=(const IOBufPool &) = delete;
+
+        static IOBufPool &get(folly::EventBase &evb);
+
+        // Returns an empty IOBuf with at least size bytes of tailroom
+        std::unique_ptr<folly::IOBuf> acquire(size_t size);
+
+    private:
+        struct Deleter
+        {
+            void operator()(IOBufPool *pool) const;
+        };
+
+        // Written over a buffer while it sits on a freelist or the queue
+        struct FreeNode
+        {
+            folly::AtomicIntrusiveLinkedListHook<FreeNode> hook;
+            uint8_t cls;
+        };
+
+        ~IOBufPool();
+
+        static void freeBuffer(void *buf, void *userData);
+        void releaseRemote(void *buf, uint8_t cls);
+        void recycle(void *buf, uint8_t cls);
+        void drainRemote();
+        void unref();
+
+        const std::thread::id owner_;
+        const size_t maxCachedBytes_;
+        size_t cachedBytes_{0};
+        // Set once the event base dropped the pool; read by releasing threads
+        std::atomic<bool> detached_{false};
+        // Bytes on remote_, bounded like the freelists
+        std::atomic<size_t> remoteBytes_{0};
+        // Remote releases freed over that bound, not yet taken off inUse
+        std::atomic<size_t> remoteDropped_{0};
+        std::array<std::vector<void *>, kNumClasses> free_;
+        folly::AtomicIntrusiveLinkedList<FreeNode, &FreeNode::hook> remote_;
+        // One for the event base plus one per outstanding buffer
+        std::atomic<size_t> refs_{1};
+
+        struct Stats
+        {
+            WorkerCounter reused;
+            WorkerCounter allocated;
+            WorkerCounter remoteFrees;
+            WorkerCounter cachedBytes;
+            WorkerCounter inUse;
+        };
+        Stats stats_;
+        uint64_t statsId_{0};
+    };
+
+} // namespace quic::samples
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "IoScheduler.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <folly/Conv.h>
+#include <folly/io/async/EventBaseLocal.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+
+DEFINE_uint32(static_io_max_inflight,
+              64,
+              "File reads a worker keeps in its io_uring at once; keep it well "
+              "below the ring capacity so network I/O always finds SQEs");
+DEFINE_uint32(static_io_small_reserve,
+              8,
+              "Of --static_io_max_inflight, reads only small-file flows may use");
+DEFINE_uint32(static_io_quantum_kb,
+              128,
+              "Bytes each flow may submit per deficit round-robin round, in KB");
+DEFINE_uint64(static_io_small_kb,
+              256,
+              "Files up to this size (KB) are latency sensitive and may use the "
+              "reserved read slots");
+
+namespace
+{
+    constexpr const char *kBucketNames[] = {
+        "le_10", "le_100", "le_1000", "le_10000", "le_100000", "inf"};
+}
+
+namespace quic::samples
+{
+    IoScheduler::IoScheduler(folly::EventBase *evb)
+        : backend_(dynamic_cast<folly::IoUringBackend *>(evb->getBackend()))
+    {
+        static_assert(std::size(kBucketNames) == kDelayBuckets, "one name per bucket");
+        statsId_ = StatsRegistry::get().addSource(
+            [this](StatsRegistry::Emit emit)
+            {
+                emit("io_scheduler.inflight", stats_.inflight.get());
+                emit("io_scheduler.queued", stats_.queued.get());
+                for (size_t i = 0; i < kDelayBuckets; ++i)
+                {
+                    emit(folly::to<std::string>("io_scheduler.small_delay_us.", kBucketNames[i]),
+                         stats_.smallDelay[i].get());
+                    emit(folly::to<std::string>("io_scheduler.large_delay_us.", kBucketNames[i]),
+                         stats_.largeDelay[i].get());
+                }
+            });
+    }
+
+    IoScheduler::~IoScheduler()
+    {
+        StatsRegistry::get().removeSource(statsId_);
+    }
+
+    IoScheduler &IoScheduler::get(folly::EventBase &evb)
+    {
+        static folly::EventBaseLocal<std::unique_ptr<IoScheduler>> schedulers;
+        auto &scheduler = schedulers.try_emplace_with(
+            evb, [&evb] { return std::make_unique<IoScheduler>(&evb); });
+        return *scheduler;
+    }
+
+    void IoScheduler::submit(const void *flow, uint64_t fileSize, FileReadIoSqe *sqe)
+    {
+        auto [it, inserted] = flows_.try_emplace(flow);
+        auto &state = it->second;
+        if (inserted)
+        {
+            state.small = fileSize <= (FLAGS_static_io_small_kb << 10);
+        }
+        state.queue.push_back(Pending{sqe, Clock::now()});
+        stats_.queued.set(++queued_);
+        if (!state.active)
+        {
+            state.active = true;
+            active_.push_back(&state);
+        }
+        dispatch();
+    }
+
+    void IoScheduler::cancel(const void *flow, FileReadIoSqe *sqe)
+    {
+        auto it = flows_.find(flow);
+        if (it != flows_.end())
+        {
+            auto &queue = it->second.queue;
+            auto pending = std::find_if(
+                queue.begin(), queue.end(), [sqe](const Pending &p) { return p.sqe == sqe; });
+            if (pending != queue.end())
+            {
+                // Never reached the ring
+                queue.erase(pending);
+                stats_.queued.set(--queued_);
+                delete sqe;
+                return;
+            }
+        }
+        backend_->cancel(sqe);
+    }
+
+    void IoScheduler::removeFlow(const void *flow)
+    {
+        auto it = flows_.find(flow);
+        if (it == flows_.end())
+        {
+            return;
+        }
+        DCHECK(it->second.queue.empty());
+        active_.erase(std::remove(active_.begin(), active_.end(), &it->second), active_.end());
+        flows_.erase(it);
+    }
+
+    void IoScheduler::onReadDone() noexcept
+    {
+        stats_.inflight.set(--inflight_);
+        dispatch();
+    }
+
+    void IoScheduler::dispatch()
+    {
+        const size_t quantum = size_t(FLAGS_static_io_quantum_kb) << 10;
+        const size_t max = std::max<uint32_t>(FLAGS_static_io_max_inflight, 1);
+        const size_t largeMax = max - std::min<size_t>(FLAGS_static_io_small_reserve, max - 1);
+        // Rounds continue while some flow had a free slot: its deficit grew,
+        // so it eventually covers the read at its head
+        bool eligible = true;
+        while (eligible && !active_.empty() && inflight_ < max)
+        {
+            eligible = false;
+            for (size_t n = active_.size(); n > 0 && !active_.empty(); --n)
+            {
+                auto *flow = active_.front();
+                active_.pop_front();
+                size_t limit = flow->small ? max : largeMax;
+                if (inflight_ >= limit)
+                {
+                    active_.push_back(flow);
+                    continue;
+                }
+                eligible = true;
+                flow->deficit += quantum;
+                auto now = Clock::now();
+                while (!flow->queue.empty() && inflight_ < limit &&
+                       flow->queue.front().sqe->length() <= flow->deficit)
+                {
+                    auto pending = flow->queue.front();
+                    flow->queue.pop_front();
+                    flow->deficit -= pending.sqe->length();
+                    recordDelay(flow->small, now - pending.queued);
+                    pending.sqe->setObserver(this);
+                    backend_->submitSoon(*pending.sqe);
+                    stats_.queued.set(--queued_);
+                    stats_.inflight.set(++inflight_);
+                }
+                if (flow->queue.empty())
+                {
+                    // An idle flow does not bank credit
+                    flow->deficit = 0;
+                    flow->active = false;
+                }
+                else
+                {
+                    active_.push_back(flow);
+                }
+            }
+        }
+    }
+
+    void IoScheduler::recordDelay(bool small, Clock::duration delay)
+    {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(delay).count();
+        size_t bucket = 0;
+        for (int64_t bound = 10; bucket + 1 < kDelayBuckets && us > bound; bound *= 10)
+        {
+            ++bucket;
+        }
+        (small ? stats_.smallDelay : stats_.largeDelay)[bucket].add();
+    }
+
+} // namespace quic::samples
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/IoUringBackend.h>
+
+#include "FileIoSqe.h"
+#include "ServerStats.h"
+
+namespace quic::samples
+{
+    /*
+     * Per event base arbiter of file reads between the transactions of a
+     * worker.
+     *
+     * Each issuer is a flow with its own queue; queued reads go to the ring
+     * in deficit round-robin order, so a flow gets a quantum of bytes per
+     * round however large its reads are. At most --static_io_max_inflight
+     * reads are in the ring at once, and the last --static_io_small_reserve
+     * of those slots are kept for small-file flows: a few huge downloads can
+     * fill their share but never the ring, and a small file waits at most
+     * one round.
+     *
+     * Time spent queued is recorded per flow class in power of ten
+     * microsecond buckets and exported with the server stats.
+     */
+    class IoScheduler : private ReadDoneObserver
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit IoScheduler(folly::EventBase *evb);
+        ~IoScheduler();
+
+        static IoScheduler &get(folly::EventBase &evb);
+
+        // Queues sqe on flow, a flow of a file of fileSize bytes, and submits
+        // what the round-robin allows. The sqe may be submitted before this
+        // returns.
+        void submit(const void *flow, uint64_t fileSize, FileReadIoSqe *sqe);
+
+        // Drops sqe if still queued, else asks the kernel to cancel it
+        void cancel(const void *flow, FileReadIoSqe *sqe);
+
+        // The flow is gone; its queue must be empty
+        void removeFlow(const void *flow);
+
+    private:
+        static constexpr size_t kDelayBuckets = 6;
+
+        struct Pending
+        {
+            FileReadIoSqe *sqe;
+            Clock::time_point queued;
+        };
+
+        struct Flow
+        {
+            std::deque<Pending> queue;
+            size_t deficit{0};
+            bool small{false};
+            bool active{false};
+        };
+
+        void onReadDone() noexcept override;
+
+        void dispatch();
+        void recordDelay(bool small, Clock::duration delay);
+
+        folly::IoUringBackend *backend_;
+        std::unordered_map<const void *, Flow> flows_;
+        // Flows with queued reads in round-robin order
+        std::deque<Flow *> active_;
+        size_t inflight_{0};
+        size_t queued_{0};
+
+        struct Stats
+        {
+            WorkerCounter inflight;
+            WorkerCounter queued;
+            // <=10us, <=100us, ... , >100ms
+            std::array<WorkerCounter, kDelayBuckets> smallDelay;
+            std::array<WorkerCounter, kDelayBuckets> largeDelay;
+        };
+        Stats stats_;
+        uint64_t statsId_{0};
+    };
+
+} // namespace quic::samples
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "IoUringProfile.h"
+#include "AffinityPlan.h"
+
+#include <atomic>
+
+#include <folly/Conv.h>
+#include <folly/ExceptionString.h>
+#include <folly/io/async/Liburing.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+
+#if FOLLY_HAS_LIBURING
+#include <liburing.h>
+#endif
+
+DEFINE_bool(io_uring, true, "Run event bases on io_uring; false forces epoll");
+DEFINE_bool(use_iouring_event_eventfd, true, "Register the ring fd with the ring");
+DEFINE_int32(io_capacity, 512, "Submission queue entries per ring");
+DEFINE_int32(io_submit_sqe, 0, "SQEs submitted per io_uring_enter, 0 for the default");
+DEFINE_int32(io_max_get, 0, "Completions reaped per loop, 0 for the default");
+DEFINE_bool(set_iouring_defer_taskrun,
+            true,
+            "Use IORING_SETUP_DEFER_TASKRUN where the kernel supports it");
+DEFINE_int32(io_max_submit, 0, "SQEs queued before a submit, 0 for the default");
+DEFINE_int32(io_registers, 2048, "Registered file slots per ring, 0 to disable");
+DEFINE_int32(io_prov_buffs_size, 2048, "Size of each provided receive buffer");
+DEFINE_int32(io_prov_buffs, 2000, "Provided receive buffers per ring, 0 to disable");
+DEFINE_bool(io_zcrx, false, "Zero copy receive where the kernel and NIC support it");
+DEFINE_int32(io_zcrx_num_pages, 16384, "Pages of the zero copy receive area");
+DEFINE_int32(io_zcrx_refill_entries, 16384, "Zero copy receive refill ring entries");
+DEFINE_string(io_zcrx_ifname, "eth0", "Interface zero copy receive binds to");
+DEFINE_int32(io_zcrx_queue_id, 0, "First NIC RX queue for zero copy receive; rings "
+                                  "take consecutive queues");
+
+#if FOLLY_HAVE_WEAK_SYMBOLS
+FOLLY_ATTR_WEAK int resolve_napi_callback(int /*ifindex*/, uint32_t /*queueId*/);
+#else
+static int resolve_napi_callback(int /*ifindex*/, uint32_t /*queueId*/)
+{
+    return -1;
+}
+#endif
+
+namespace
+{
+    size_t positive(int32_t value)
+    {
+        return value > 0 ? static_cast<size_t>(value) : 0;
+    }
+}
+
+namespace quic::samples
+{
+    IoUringFeatures IoUringProfile::probe()
+    {
+        IoUringFeatures features;
+#if FOLLY_HAS_LIBURING
+        features.available = folly::IoUringBackend::isAvailable();
+        if (!features.available)
+        {
+            return features;
+        }
+        features.deferTaskrun = folly::IoUringBackend::kernelSupportsDeferTaskrun();
+        features.recvmsgMultishot = folly::IoUringBackend::kernelSupportsRecvmsgMultishot();
+        // The rest needs a ring to ask
+        struct io_uring ring;
+        if (io_uring_queue_init(2, &ring, 0) != 0)
+        {
+            return features;
+        }
+        int ret = 0;
+        if (auto *br = io_uring_setup_buf_ring(&ring, 2, 0, 0, &ret))
+        {
+            features.providedBufferRings = true;
+            io_uring_free_buf_ring(&ring, br, 2, 0);
+        }
+        // IORING_OP_RECV_ZC is an enum value, not a macro: its header comes
+        // with liburing 2.10
+#if defined(IO_URING_VERSION_MAJOR) && \
+    (IO_URING_VERSION_MAJOR > 2 || (IO_URING_VERSION_MAJOR == 2 && IO_URING_VERSION_MINOR >= 10))
+        if (auto *probe = io_uring_get_probe_ring(&ring))
+        {
+            features.zeroCopyRx = io_uring_opcode_supported(probe, IORING_OP_RECV_ZC);
+            io_uring_free_probe(probe);
+        }
+#endif
+        io_uring_queue_exit(&ring);
+#endif
+        return features;
+    }
+
+    IoUringProfile::IoUringProfile() : features_(probe())
+    {
+        enabled_ = FLAGS_io_uring && features_.available;
+        if (FLAGS_io_uring && !features_.available)
+        {
+            LOG(WARNING) << "io_uring is not available, event bases use epoll";
+        }
+        registerRingFd_ = FLAGS_use_iouring_event_eventfd;
+        capacity_ = positive(FLAGS_io_capacity);
+        sqeSize_ = positive(FLAGS_io_submit_sqe);
+        maxGet_ = positive(FLAGS_io_max_get);
+        maxSubmit_ = positive(FLAGS_io_max_submit);
+        registeredFds_ = positive(FLAGS_io_registers);
+        if (FLAGS_io_prov_buffs_size > 0 && FLAGS_io_prov_buffs > 0)
+        {
+            if (features_.providedBufferRings)
+            {
+                providedBufferSize_ = positive(FLAGS_io_prov_buffs_size);
+                providedBuffers_ = positive(FLAGS_io_prov_buffs);
+            }
+            else if (enabled_)
+            {
+                LOG(WARNING) << "Kernel lacks provided buffer rings, receiving without them";
+            }
+        }
+        sqpollCpu_ = AffinityPlan::get().sqpollCpu();
+        if (sqpollCpu_ && FLAGS_set_iouring_defer_taskrun)
+        {
+            // The kernel rejects DEFER_TASKRUN on SQPOLL rings
+            LOG(INFO) << "SQPOLL on cpu " << *sqpollCpu_ << ", not setting DEFER_TASKRUN";
+        }
+        deferTaskrun_ = FLAGS_set_iouring_defer_taskrun && features_.deferTaskrun && !sqpollCpu_;
+        if (enabled_ && FLAGS_set_iouring_defer_taskrun && !features_.deferTaskrun && !sqpollCpu_)
+        {
+            LOG(WARNING) << "Kernel lacks DEFER_TASKRUN, not setting it";
+        }
+        zeroCopyRx_ = FLAGS_io_zcrx && features_.zeroCopyRx;
+        if (enabled_ && FLAGS_io_zcrx && !features_.zeroCopyRx)
+        {
+            LOG(WARNING) << "Kernel lacks zero copy receive, --io_zcrx ignored";
+        }
+    }
+
+    const IoUringProfile &IoUringProfile::get()
+    {
+        static const IoUringProfile profile;
+        return profile;
+    }
+
+    folly::IoUringBackend::Options IoUringProfile::options() const
+    {
+        folly::IoUringBackend::Options options;
+        options.setRegisterRingFd(registerRingFd_);
+        if (capacity_)
+        {
+            options.setCapacity(capacity_);
+        }
+        if (sqeSize_)
+        {
+            options.setSqeSize(sqeSize_);
+        }
+        if (maxGet_)
+        {
+            options.setMaxGet(maxGet_);
+        }
+        if (maxSubmit_)
+        {
+            options.setMaxSubmit(maxSubmit_);
+        }
+        if (registeredFds_)
+        {
+            options.setUseRegisteredFds(registeredFds_);
+        }
+        if (providedBuffers_)
+        {
+            options.setInitialProvidedBuffers(providedBufferSize_, providedBuffers_);
+        }
+        options.setDeferTaskRun(deferTaskrun_);
+        if (sqpollCpu_)
+        {
+            // One kernel thread polls the submission queues of all rings
+            options.setFlags(folly::IoUringBackend::Options::Flags::POLL_SQ)
+                .setSQGroupName("fast_eb")
+                .setSQCpu(*sqpollCpu_);
+        }
+        if (zeroCopyRx_)
+        {
+            static std::atomic<int32_t> nextQueue{FLAGS_io_zcrx_queue_id};
+            options.setZeroCopyRx(true)
+                .setZeroCopyRxInterface(FLAGS_io_zcrx_ifname)
+                .setZeroCopyRxQueue(nextQueue.fetch_add(1))
+                .setZeroCopyRxNumPages(positive(FLAGS_io_zcrx_num_pages))
+                .setZeroCopyRxRefillEntries(positive(FLAGS_io_zcrx_refill_entries))
+                .setResolveNapiCallback(resolve_napi_callback);
+        }
+        return options;
+    }
+
+    std::unique_ptr<folly::EventBaseBackendBase> IoUringProfile::makeBackend()
+    {
+        const auto &profile = get();
+        if (profile.enabled())
+        {
+            try
+            {
+                return std::make_unique<folly::IoUringBackend>(profile.options());
+            }
+            catch (const std::exception &ex)
+            {
+                // Typically RLIMIT_MEMLOCK or a zero copy queue in use
+                LOG(ERROR) << "Failed to create io_uring backend, using epoll: "
+                           << folly::exceptionStr(ex);
+            }
+        }
+        return folly::EventBase::getDefaultBackend();
+    }
+
+    bool IoUringProfile::usesIoUring(folly::EventBase &evb)
+    {
+        return dynamic_cast<folly::IoUringBackend *>(evb.getBackend()) != nullptr;
+    }
+
+    std::string IoUringProfile::describe() const
+    {
+        if (!enabled_)
+        {
+            return "io_uring disabled, epoll";
+        }
+        return folly::to<std::string>(
+            "io_uring capacity=", capacity_,
+            " registered_fds=", registeredFds_,
+            " provided_buffers=", providedBuffers_, "x", providedBufferSize_,
+            " defer_taskrun=", deferTaskrun_,
+            " register_ring_fd=", registerRingFd_,
+            " sqpoll_cpu=", sqpollCpu_ ? folly::to<std::string>(*sqpollCpu_) : std::string("off"),
+            " max_submit=", maxSubmit_,
+            " max_get=", maxGet_,
+            " zcrx=", zeroCopyRx_ ? FLAGS_io_zcrx_ifname : std::string("off"),
+            " | kernel: defer_taskrun=", features_.deferTaskrun,
+            " recvmsg_multishot=", features_.recvmsgMultishot,
+            " buf_rings=", features_.providedBufferRings,
+            " recv_zc=", features_.zeroCopyRx);
+    }
+
+} // namespace quic::samples
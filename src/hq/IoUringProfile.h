@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/IoUringBackend.h>
+
+namespace quic::samples
+{
+    // io_uring features of the running kernel that the profile depends on
+    struct IoUringFeatures
+    {
+        bool available{false};
+        bool deferTaskrun{false};
+        bool recvmsgMultishot{false};
+        bool providedBufferRings{false};
+        bool zeroCopyRx{false};
+    };
+
+    /*
+     * The io_uring settings every event base of the process is created with.
+     *
+     * Built once from the --io_* flags and the kernel features probed at
+     * startup: a feature the kernel lacks is left off with a warning instead
+     * of failing ring creation. makeBackend() is the backend factory of the
+     * process EventBaseManager; when io_uring is unavailable, or a ring
+     * cannot be created, it hands out the default epoll backend and the
+     * server runs without the io_uring file paths. With an SQPOLL CPU in the
+     * AffinityPlan all rings share one polling thread pinned there.
+     */
+    class IoUringProfile
+    {
+    public:
+        static const IoUringProfile &get();
+
+        const IoUringFeatures &features() const { return features_; }
+
+        // Whether event bases get io_uring backends at all
+        bool enabled() const { return enabled_; }
+
+        // Options for the next ring; each ring gets its own zero copy RX
+        // queue
+        folly::IoUringBackend::Options options() const;
+
+        // Backend for a new event base
+        static std::unique_ptr<folly::EventBaseBackendBase> makeBackend();
+
+        // Whether evb runs on io_uring
+        static bool usesIoUring(folly::EventBase &evb);
+
+        // One line summary of the effective settings
+        std::string describe() const;
+
+    private:
+        IoUringProfile();
+
+        static IoUringFeatures probe();
+
+        IoUringFeatures features_;
+        bool enabled_{false};
+        bool registerRingFd_{false};
+        size_t capacity_{0};
+        size_t sqeSize_{0};
+        size_t maxGet_{0};
+        size_t maxSubmit_{0};
+        size_t registeredFds_{0};
+        size_t providedBufferSize_{0};
+        size_t providedBuffers_{0};
+        bool deferTaskrun_{false};
+        std::optional<int> sqpollCpu_;
+        bool zeroCopyRx_{false};
+    };
+
+} // namespace quic::samples
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <string_view>
+
+namespace quic::samples
+{
+    struct MimeType
+    {
+        std::string_view extension;
+        std::string_view type;
+    };
+
+    // Lower case extensions of the assets a web front end ships
+    constexpr MimeType kMimeTypes[] = {
+        {"avif", "image/avif"},
+        {"bmp", "image/bmp"},
+        {"css", "text/css; charset=utf-8"},
+        {"csv", "text/csv; charset=utf-8"},
+        {"gif", "image/gif"},
+        {"gz", "application/gzip"},
+        {"htm", "text/html; charset=utf-8"},
+        {"html", "text/html; charset=utf-8"},
+        {"ico", "image/vnd.microsoft.icon"},
+        {"jpeg", "image/jpeg"},
+        {"jpg", "image/jpeg"},
+        {"js", "text/javascript; charset=utf-8"},
+        {"json", "application/json"},
+        {"map", "application/json"},
+        {"md", "text/markdown; charset=utf-8"},
+        {"mjs", "text/javascript; charset=utf-8"},
+        {"mp3", "audio/mpeg"},
+        {"mp4", "video/mp4"},
+        {"ogg", "audio/ogg"},
+        {"otf", "font/otf"},
+        {"pdf", "application/pdf"},
+        {"png", "image/png"},
+        {"svg", "image/svg+xml"},
+        {"ttf", "font/ttf"},
+        {"txt", "text/plain; charset=utf-8"},
+        {"wasm", "application/wasm"},
+        {"webm", "video/webm"},
+        {"webmanifest", "application/manifest+json"},
+        {"webp", "image/webp"},
+        {"woff", "font/woff"},
+        {"woff2", "font/woff2"},
+        {"xml", "application/xml"},
+        {"zip", "application/zip"},
+        {"zst", "application/zstd"},
+    };
+
+    constexpr std::string_view kDefaultMimeType = "application/octet-stream";
+
+    namespace detail
+    {
+        constexpr bool equalsLower(std::string_view a, std::string_view lower)
+        {
+            if (a.size() != lower.size())
+            {
+                return false;
+            }
+            for (size_t i = 0; i < a.size(); ++i)
+            {
+                char c = a[i] >= 'A' && a[i] <= 'Z' ? char(a[i] - 'A' + 'a') : a[i];
+                if (c != lower[i])
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    // Content-Type for a path by its extension, ignoring case
+    constexpr std::string_view mimeTypeFor(std::string_view path)
+    {
+        auto slash = path.rfind('/');
+        auto name = slash == std::string_view::npos ? path : path.substr(slash + 1);
+        auto dot = name.rfind('.');
+        if (dot == std::string_view::npos)
+        {
+            return kDefaultMimeType;
+        }
+        auto extension = name.substr(dot + 1);
+        for (const auto &mime : kMimeTypes)
+        {
+            if (detail::equalsLower(extension, mime.extension))
+            {
+                return mime.type;
+            }
+        }
+        return kDefaultMimeType;
+    }
+
+    static_assert(mimeTypeFor("/app/main.JS") == "text/javascript; charset=utf-8");
+    static_assert(mimeTypeFor("/LICENSE") == kDefaultMimeType);
+
+} // namespace quic::samples
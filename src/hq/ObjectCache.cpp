@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ObjectCache.h"
+
+#include <algorithm>
+
+#include <folly/io/async/EventBaseLocal.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+
+#include "ServerConfig.h"
+
+DEFINE_uint64(static_object_cache_mb,
+              64,
+              "Per worker memory budget of the static body cache in MB. "
+              "0 disables the cache.");
+DEFINE_uint64(static_object_max_kb,
+              1024,
+              "Largest static file kept in the body cache, in KB");
+
+namespace
+{
+    constexpr size_t kMaxFreq = 3;
+    constexpr size_t kMinGhosts = 1024;
+}
+
+namespace quic::samples
+{
+    ObjectCache::ObjectCache(std::string name, size_t capacity, size_t maxObjectSize)
+        : name_(std::move(name)),
+          capacity_(capacity),
+          maxObjectSize_(std::min(maxObjectSize, capacity)),
+          smallCapacity_(capacity / 10)
+    {
+        statsId_ = StatsRegistry::get().addSource(
+            [this](StatsRegistry::Emit emit)
+            {
+                emit(name_ + ".hits", stats_.hits.get());
+                emit(name_ + ".misses", stats_.misses.get());
+                emit(name_ + ".inserts", stats_.inserts.get());
+                emit(name_ + ".rejects", stats_.rejects.get());
+                emit(name_ + ".evictions", stats_.evictions.get());
+                emit(name_ + ".promotions", stats_.promotions.get());
+                emit(name_ + ".bytes", stats_.bytes.get());
+                emit(name_ + ".objects", stats_.objects.get());
+            });
+    }
+
+    ObjectCache::~ObjectCache()
+    {
+        StatsRegistry::get().removeSource(statsId_);
+    }
+
+    ObjectCache &ObjectCache::get(folly::EventBase &evb)
+    {
+        static folly::EventBaseLocal<std::unique_ptr<ObjectCache>> caches;
+        auto &cache = caches.try_emplace_with(
+            evb,
+            []
+            {
+                return std::make_unique<ObjectCache>(
+                    "object_cache",
+                    FLAGS_static_object_cache_mb << 20,
+                    FLAGS_static_object_max_kb << 10);
+            });
+        auto config = ConfigStore::current();
+        if (cache->configVersion_ != config->version)
+        {
+            cache->configVersion_ = config->version;
+            cache->resize(config->objectCacheMb << 20, config->objectMaxKb << 10);
+        }
+        return *cache;
+    }
+
+    void ObjectCache::resize(size_t capacity, size_t maxObjectSize)
+    {
+        capacity_ = capacity;
+        maxObjectSize_ = std::min(maxObjectSize, capacity);
+        smallCapacity_ = capacity / 10;
+        evict();
+    }
+
+    std::unique_ptr<folly::IOBuf> ObjectCache::lookup(const std::string &key,
+                                                      const std::string &etag)
+    {
+        auto it = index_.find(key);
+        if (it == index_.end())
+        {
+            stats_.misses.add();
+            return nullptr;
+        }
+        auto &entry = *it->second;
+        if (entry.etag != etag)
+        {
+            remove(it->second);
+            stats_.misses.add();
+            return nullptr;
+        }
+        entry.freq = std::min<uint8_t>(entry.freq + 1, kMaxFreq);
+        stats_.hits.add();
+        return entry.body->clone();
+    }
+
+    void ObjectCache::insert(const std::string &key,
+                             const std::string &etag,
+                             std::unique_ptr<folly::IOBuf> body)
+    {
+        auto size = body->computeChainDataLength();
+        if (size == 0 || !fits(size))
+        {
+            stats_.rejects.add();
+            return;
+        }
+        erase(key);
+        body->coalesce();
+
+        bool ghost = takeGhost(key);
+        auto &queue = ghost ? main_ : small_;
+        queue.push_front(Entry{key, etag, std::move(body), size, 0, ghost});
+        index_.emplace(key, queue.begin());
+        (ghost ? mainBytes_ : smallBytes_) += size;
+        stats_.inserts.add();
+        stats_.objects.add();
+        stats_.bytes.add(size);
+        evict();
+    }
+
+    void ObjectCache::erase(const std::string &key)
+    {
+        auto it = index_.find(key);
+        if (it != index_.end())
+        {
+            remove(it->second);
+        }
+    }
+
+    void ObjectCache::remove(Queue::iterator it)
+    {
+        (it->main ? mainBytes_ : smallBytes_) -= it->size;
+        stats_.objects.sub();
+        stats_.bytes.sub(it->size);
+        index_.erase(it->key);
+        (it->main ? main_ : small_).erase(it);
+    }
+
+    void ObjectCache::evict()
+    {
+        while (bytes() > capacity_)
+        {
+            if (!small_.empty() && (smallBytes_ >= smallCapacity_ || main_.empty()))
+            {
+                evictSmall();
+            }
+            else
+            {
+                evictMain();
+            }
+        }
+    }
+
+    void ObjectCache::evictSmall()
+    {
+        auto it = std::prev(small_.end());
+        if (it->freq > 0)
+        {
+            // Hit while in the probationary queue: promote to main
+            it->freq = 0;
+            it->main = true;
+            smallBytes_ -= it->size;
+            mainBytes_ += it->size;
+            main_.splice(main_.begin(), small_, it);
+            stats_.promotions.add();
+            return;
+        }
+        addGhost(it->key);
+        stats_.evictions.add();
+        remove(it);
+    }
+
+    void ObjectCache::evictMain()
+    {
+        auto it = std::prev(main_.end());
+        if (it->freq > 0)
+        {
+            --it->freq;
+            main_.splice(main_.begin(), main_, it);
+            return;
+        }
+        stats_.evictions.add();
+        remove(it);
+    }
+
+    void ObjectCache::addGhost(const std::string &key)
+    {
+        auto hash = std::hash<std::string>()(key);
+        ghostFifo_.push_back(hash);
+        ++ghosts_[hash];
+        auto limit = std::max(kMinGhosts, index_.size());
+        while (ghostFifo_.size() > limit)
+        {
+            auto old = ghostFifo_.front();
+            ghostFifo_.pop_front();
+            auto it = ghosts_.find(old);
+            if (it != ghosts_.end() && --it->second == 0)
+            {
+                ghosts_.erase(it);
+            }
+        }
+    }
+
+    bool ObjectCache::takeGhost(const std::string &key)
+    {
+        auto it = ghosts_.find(std::hash<std::string>()(key));
+        if (it == ghosts_.end())
+        {
+            return false;
+        }
+        // The fifo slot ages out on its own; forgetting the key here keeps a
+        // second insert of the same object from skipping probation again
+        ghosts_.erase(it);
+        return true;
+    }
+
+} // namespace quic::samples
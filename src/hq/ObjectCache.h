@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <deque>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+
+#include "ServerStats.h"
+
+namespace quic::samples
+{
+    /*
+     * Byte budgeted in-memory cache of whole response bodies.
+     *
+     * Every body is stored as one contiguous IOBuf and a hit hands out a
+     * clone() of it, so serving from the cache needs neither a copy nor a
+     * syscall. Entries are versioned by ETag; a lookup with a different ETag
+     * is a miss and drops the stale body.
+     *
+     * Admission and eviction follow S3-FIFO: new objects enter a small FIFO
+     * (10% of the budget) and are only promoted to the main FIFO if they were
+     * hit again before reaching its tail. Objects evicted from the small
+     * queue leave their key in a ghost queue, and a re-insert of a ghost goes
+     * straight to main. A one-pass scan therefore only churns the small
+     * queue and cannot flush the hot set.
+     *
+     * One instance per event base; not thread safe.
+     */
+    class ObjectCache
+    {
+    public:
+        ObjectCache(std::string name, size_t capacity, size_t maxObjectSize);
+        ~ObjectCache();
+
+        // Returns the body cache of the given event base, sized by the
+        // running ServerConfig
+        static ObjectCache &get(folly::EventBase &evb);
+
+        // Changes the budget, evicting down to it
+        void resize(size_t capacity, size_t maxObjectSize);
+
+        // Returns a clone of the cached body, or nullptr on a miss
+        std::unique_ptr<folly::IOBuf> lookup(const std::string &key,
+                                             const std::string &etag);
+
+        bool fits(size_t size) const { return size <= maxObjectSize_; }
+
+        // Stores body under key; the chain is coalesced into one buffer
+        void insert(const std::string &key,
+                    const std::string &etag,
+                    std::unique_ptr<folly::IOBuf> body);
+
+        void erase(const std::string &key);
+
+        size_t bytes() const { return smallBytes_ + mainBytes_; }
+
+    private:
+        struct Entry
+        {
+            std::string key;
+            std::string etag;
+            std::unique_ptr<folly::IOBuf> body;
+            size_t size{0};
+            uint8_t freq{0};
+            bool main{false};
+        };
+        using Queue = std::list<Entry>;
+
+        void evict();
+        void evictSmall();
+        void evictMain();
+        void remove(Queue::iterator it);
+        void addGhost(const std::string &key);
+        bool takeGhost(const std::string &key);
+
+        struct Stats
+        {
+            WorkerCounter hits;
+            WorkerCounter misses;
+            WorkerCounter inserts;
+            WorkerCounter rejects;
+            WorkerCounter evictions;
+            WorkerCounter promotions;
+            WorkerCounter bytes;
+            WorkerCounter objects;
+        };
+
+        std::string name_;
+        size_t capacity_;
+        size_t maxObjectSize_;
+        size_t smallCapacity_;
+        size_t smallBytes_{0};
+        size_t mainBytes_{0};
+        // front is the newest entry, back the next eviction candidate
+        Queue small_;
+        Queue main_;
+        std::unordered_map<std::string, Queue::iterator> index_;
+        std::deque<size_t> ghostFifo_;
+        std::unordered_map<size_t, uint32_t> ghosts_;
+        Stats stats_;
+        uint64_t statsId_{0};
+        // ServerConfig version the body cache was sized by
+        uint64_t configVersion_{0};
+    };
+
+} // namespace quic::samples
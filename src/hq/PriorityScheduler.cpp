@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "PriorityScheduler.h"
+
+#include <algorithm>
+
+#include <folly/io/async/EventBaseLocal.h>
+#include <glog/logging.h>
+
+namespace quic::samples
+{
+    PriorityScheduler::PriorityScheduler()
+    {
+        statsId_ = StatsRegistry::get().addSource(
+            [this](StatsRegistry::Emit emit)
+            {
+                emit("priority.streams", stats_.streams.get());
+                emit("priority.throttled", stats_.throttled.get());
+            });
+    }
+
+    PriorityScheduler::~PriorityScheduler()
+    {
+        StatsRegistry::get().removeSource(statsId_);
+    }
+
+    PriorityScheduler &PriorityScheduler::get(folly::EventBase &evb)
+    {
+        static folly::EventBaseLocal<std::unique_ptr<PriorityScheduler>> schedulers;
+        auto &scheduler = schedulers.try_emplace_with(
+            evb, [] { return std::make_unique<PriorityScheduler>(); });
+        return *scheduler;
+    }
+
+    uint64_t PriorityScheduler::add(const void *conn, Priority priority)
+    {
+        auto id = nextId_++;
+        conns_[conn].push_back(Stream{id, priority});
+        stats_.streams.add();
+        return id;
+    }
+
+    void PriorityScheduler::update(const void *conn, uint64_t id, Priority priority)
+    {
+        auto it = conns_.find(conn);
+        if (it == conns_.end())
+        {
+            return;
+        }
+        for (auto &stream : it->second)
+        {
+            if (stream.id == id)
+            {
+                stream.priority = priority;
+                return;
+            }
+        }
+    }
+
+    void PriorityScheduler::remove(const void *conn, uint64_t id)
+    {
+        auto it = conns_.find(conn);
+        if (it == conns_.end())
+        {
+            return;
+        }
+        auto &streams = it->second;
+        auto stream = std::find_if(
+            streams.begin(), streams.end(), [id](const Stream &s) { return s.id == id; });
+        if (stream == streams.end())
+        {
+            return;
+        }
+        streams.erase(stream);
+        stats_.streams.sub();
+        if (streams.empty())
+        {
+            conns_.erase(it);
+        }
+    }
+
+    size_t PriorityScheduler::allowance(const void *conn, uint64_t id, size_t window, size_t block)
+    {
+        auto it = conns_.find(conn);
+        if (it == conns_.end() || it->second.size() < 2)
+        {
+            return window;
+        }
+        const auto &streams = it->second;
+        auto self = std::find_if(
+            streams.begin(), streams.end(), [id](const Stream &s) { return s.id == id; });
+        if (self == streams.end())
+        {
+            return window;
+        }
+        const auto &mine = self->priority;
+        for (auto other = streams.begin(); other != streams.end(); ++other)
+        {
+            if (other == self)
+            {
+                continue;
+            }
+            const auto &theirs = other->priority;
+            bool first = theirs.urgency < mine.urgency ||
+                         // Non-incremental peers of equal urgency go in
+                         // arrival order
+                         (theirs.urgency == mine.urgency && other < self &&
+                          !(theirs.incremental && mine.incremental));
+            if (first)
+            {
+                stats_.throttled.add();
+                return std::min(window, block);
+            }
+        }
+        return window;
+    }
+
+} // namespace quic::samples
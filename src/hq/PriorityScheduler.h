@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/io/async/EventBase.h>
+
+#include "ServerStats.h"
+
+namespace quic::samples
+{
+    /*
+     * Per event base arbitration of disk read-ahead between the static file
+     * streams of each connection, following RFC 9218 extensible priorities.
+     *
+     * Streams register with their urgency (0 most urgent, 7 least) and
+     * incremental flag while they read from disk. A stream runs at its full
+     * read window only while nothing on its connection should go first:
+     * a more urgent stream, or an earlier stream of the same urgency unless
+     * both are incremental: RFC 9218 serves non-incremental responses one
+     * after the other. Otherwise it is held to one block in flight, so it
+     * keeps trickling without taking the disk or the wire from the bytes
+     * that matter. Incremental streams of the same urgency share.
+     *
+     * The transport still orders what is written by stream priority; this
+     * keeps the reads feeding it in the same order.
+     */
+    class PriorityScheduler
+    {
+    public:
+        static constexpr uint8_t kDefaultUrgency = 3;
+
+        struct Priority
+        {
+            uint8_t urgency{kDefaultUrgency};
+            bool incremental{false};
+
+            bool operator==(const Priority &other) const
+            {
+                return urgency == other.urgency && incremental == other.incremental;
+            }
+        };
+
+        PriorityScheduler();
+        ~PriorityScheduler();
+
+        static PriorityScheduler &get(folly::EventBase &evb);
+
+        // conn identifies the connection; returns the stream's id
+        uint64_t add(const void *conn, Priority priority);
+
+        // Applies a PRIORITY_UPDATE
+        void update(const void *conn, uint64_t id, Priority priority);
+
+        void remove(const void *conn, uint64_t id);
+
+        // Bytes of read-ahead the stream may have in flight given its full
+        // window and its block size
+        size_t allowance(const void *conn, uint64_t id, size_t window, size_t block);
+
+    private:
+        struct Stream
+        {
+            uint64_t id;
+            Priority priority;
+        };
+
+        // Streams of each connection in arrival order; ids only grow
+        std::unordered_map<const void *, std::vector<Stream>> conns_;
+        uint64_t nextId_{1};
+
+        struct Stats
+        {
+            WorkerCounter streams;
+            WorkerCounter throttled;
+        };
+        Stats stats_;
+        uint64_t statsId_{0};
+    };
+
+} // namespace quic::samples
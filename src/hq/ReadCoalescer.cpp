@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ReadCoalescer.h"
+
+#include <algorithm>
+
+#include <folly/io/async/EventBaseLocal.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+
+#include "FileIoSqe.h"
+#include "IOBufPool.h"
+#include "IoScheduler.h"
+
+DEFINE_bool(static_file_coalesce_reads,
+            false,
+            "Let concurrent requests for the same file region share one read");
+DEFINE_uint32(static_file_coalesce_kb,
+              128,
+              "Grid that coalesced reads are cut on, in KB");
+DEFINE_uint32(static_file_coalesce_max_waiters,
+              64,
+              "Requests one coalesced read serves at most; later ones read "
+              "on their own");
+DECLARE_uint64(static_io_small_kb);
+
+namespace quic::samples
+{
+    ReadCoalescer::ReadCoalescer(folly::EventBase *evb) : evb_(evb)
+    {
+        statsId_ = StatsRegistry::get().addSource(
+            [this](StatsRegistry::Emit emit)
+            {
+                emit("read_coalescer.submitted", stats_.submitted.get());
+                emit("read_coalescer.joined", stats_.joined.get());
+                emit("read_coalescer.overflow", stats_.overflow.get());
+            });
+    }
+
+    ReadCoalescer::~ReadCoalescer()
+    {
+        StatsRegistry::get().removeSource(statsId_);
+    }
+
+    ReadCoalescer &ReadCoalescer::get(folly::EventBase &evb)
+    {
+        static folly::EventBaseLocal<std::unique_ptr<ReadCoalescer>> coalescers;
+        auto &coalescer = coalescers.try_emplace_with(
+            evb, [&evb] { return std::make_unique<ReadCoalescer>(&evb); });
+        return *coalescer;
+    }
+
+    size_t ReadCoalescer::grid()
+    {
+        return FLAGS_static_file_coalesce_reads ? size_t(FLAGS_static_file_coalesce_kb) << 10 : 0;
+    }
+
+    void ReadCoalescer::read(std::shared_ptr<const CachedFile> file,
+                             off_t offset,
+                             size_t len,
+                             bool async,
+                             Callback cb)
+    {
+        Key key{file->stat.st_dev, file->stat.st_ino, offset, len};
+        auto &waiters = pending_[key];
+        if (waiters.size() >= std::max<uint32_t>(FLAGS_static_file_coalesce_max_waiters, 1))
+        {
+            // The pending read stays keyed; this one completes only cb
+            stats_.overflow.add();
+            submit(std::move(file), nullptr, offset, len, async, std::move(cb));
+            return;
+        }
+        waiters.push_back(std::move(cb));
+        if (waiters.size() > 1)
+        {
+            stats_.joined.add();
+            return;
+        }
+        stats_.submitted.add();
+        submit(std::move(file), &key, offset, len, async, nullptr);
+    }
+
+    void ReadCoalescer::submit(std::shared_ptr<const CachedFile> file,
+                               const Key *key,
+                               off_t offset,
+                               size_t len,
+                               bool async,
+                               Callback cb)
+    {
+        uint64_t size = file->stat.st_size;
+        // The sqe can wait in the IoScheduler after the requester is gone
+        // and the cache dropped the file
+        int fd = file->readFd();
+        int fixedIndex = file->fixedIndex();
+        FileReadIoSqe::Callback done;
+        if (key)
+        {
+            done = [this, key = *key, file = std::move(file)](std::unique_ptr<folly::IOBuf> buf,
+                                                              int res)
+            { complete(key, std::move(buf), res); };
+        }
+        else
+        {
+            done = [file = std::move(file), cb = std::move(cb)](std::unique_ptr<folly::IOBuf> buf,
+                                                                int res) mutable
+            { cb(std::move(buf), res); };
+        }
+        auto *sqe = new FileReadIoSqe(fd,
+                                      fixedIndex,
+                                      IOBufPool::get(*evb_).acquire(len),
+                                      len,
+                                      offset,
+                                      std::move(done));
+        sqe->setAsync(async);
+        auto &scheduler = IoScheduler::get(*evb_);
+        scheduler.submit(size <= (FLAGS_static_io_small_kb << 10) ? &smallFlow_ : &largeFlow_,
+                         size,
+                         sqe);
+    }
+
+    void ReadCoalescer::complete(const Key &key, std::unique_ptr<folly::IOBuf> buf, int res)
+    {
+        auto it = pending_.find(key);
+        DCHECK(it != pending_.end());
+        auto waiters = std::move(it->second);
+        pending_.erase(it);
+        for (size_t i = 0; i + 1 < waiters.size(); ++i)
+        {
+            // Clones share the data; each waiter sets its own length
+            waiters[i](buf->clone(), res);
+        }
+        waiters.back()(std::move(buf), res);
+    }
+
+} // namespace quic::samples
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/Function.h>
+#include <folly/hash/Hash.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+
+#include "FileCache.h"
+#include "ServerStats.h"
+
+namespace quic::samples
+{
+    /*
+     * Per event base table of file reads in flight, keyed by inode, offset
+     * and length. A read of a region that is already being read joins the
+     * pending one instead of submitting its own SQE; on completion every
+     * waiter gets an IOBuf::clone() of the same buffer. Protects the disk
+     * against a herd of requests for a freshly published file whether or
+     * not the body cache holds it.
+     *
+     * Reads only meet when they cut the file the same way, so with
+     * coalescing on callers split their reads on a fixed grid (grid()).
+     *
+     * Callers reserve their ReadBudget before reading either way, so a
+     * joiner holds its share of the worker's budget like any reader. Only
+     * the shared read goes through the IoScheduler, on the coalescer's own
+     * flows: joiners cost the disk nothing and take no DRR quantum. A read
+     * serves at most --static_file_coalesce_max_waiters requests; until it
+     * completes, further requests for the region read on their own, so one
+     * slow read never holds an unbounded herd.
+     */
+    class ReadCoalescer
+    {
+    public:
+        // Gets the buffer, with the data at its head and length 0 like a
+        // fresh read, and the read result
+        using Callback = folly::Function<void(std::unique_ptr<folly::IOBuf>, int)>;
+
+        explicit ReadCoalescer(folly::EventBase *evb);
+        ~ReadCoalescer();
+
+        static ReadCoalescer &get(folly::EventBase &evb);
+
+        // Read size coalesced reads are aligned to, 0 if coalescing is off
+        static size_t grid();
+
+        // The shared read keeps file, and so its fd and fixed slot, open
+        // until it completes, whoever of its waiters is still around
+        void read(std::shared_ptr<const CachedFile> file,
+                  off_t offset,
+                  size_t len,
+                  bool async,
+                  Callback cb);
+
+    private:
+        struct Key
+        {
+            dev_t dev;
+            ino_t ino;
+            off_t offset;
+            size_t len;
+
+            bool operator==(const Key &other) const
+            {
+                return dev == other.dev && ino == other.ino &&
+                       offset == other.offset && len == other.len;
+            }
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key &key) const
+            {
+                return folly::hash::hash_combine(key.dev, key.ino, key.offset, key.len);
+            }
+        };
+
+        // Submits a read that is not in pending_ when key is null
+        void submit(std::shared_ptr<const CachedFile> file,
+                    const Key *key,
+                    off_t offset,
+                    size_t len,
+                    bool async,
+                    Callback cb);
+
+        void complete(const Key &key, std::unique_ptr<folly::IOBuf> buf, int res);
+
+        folly::EventBase *evb_;
+        std::unordered_map<Key, std::vector<Callback>, KeyHash> pending_;
+        // IoScheduler flows of the shared reads of small and large files
+        const char smallFlow_{0};
+        const char largeFlow_{0};
+
+        struct Stats
+        {
+            WorkerCounter submitted;
+            WorkerCounter joined;
+            WorkerCounter overflow;
+        };
+        Stats stats_;
+        uint64_t statsId_{0};
+    };
+
+} // namespace quic::samples
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ReadWindow.h"
+
+#include <algorithm>
+
+#include <folly/io/async/EventBaseLocal.h>
+#include <folly/lang/Bits.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+#include <wangle/acceptor/TransportInfo.h>
+
+DEFINE_string(static_file_read_policy,
+              "adaptive",
+              "Read-ahead policy of the io_uring static handler: 'adaptive' "
+              "sizes blocks and window from throughput and send capacity, "
+              "'fixed' issues 32 reads of --static_file_min_block_kb");
+DEFINE_bool(static_file_read_async,
+            false,
+            "Submit static file reads with IOSQE_ASYNC so they run in "
+            "parallel on io-wq workers instead of being tried inline");
+DEFINE_uint32(static_file_min_block_kb, 4, "Smallest static file read, in KB");
+DEFINE_uint32(static_file_max_block_kb, 1024, "Largest static file read, in KB");
+DEFINE_uint32(static_file_max_window_kb,
+              8192,
+              "Max file bytes one transaction reads ahead, in KB");
+DEFINE_uint32(static_file_worker_inflight_mb,
+              256,
+              "Max file bytes in flight across a worker's transactions, in MB");
+
+namespace
+{
+    constexpr size_t kFixedBlocks = 32;
+    // A block is about this much data at the measured read rate
+    constexpr double kBlockSeconds = 0.001;
+    // Blocks needed before a new throughput sample is taken
+    constexpr size_t kSampleBlocks = 8;
+    constexpr double kRateWeight = 0.25;
+    constexpr auto kUpdateInterval = std::chrono::milliseconds(5);
+
+    size_t clampPow2(size_t n, size_t lo, size_t hi)
+    {
+        return std::clamp<size_t>(folly::nextPowTwo(std::max<size_t>(n, 1)), lo, hi);
+    }
+}
+
+namespace quic::samples
+{
+    ReadBudget::ReadBudget(size_t limit) : limit_(limit)
+    {
+        statsId_ = StatsRegistry::get().addSource(
+            [this](StatsRegistry::Emit emit)
+            {
+                emit("read_window.inflight_bytes", stats_.inflightBytes.get());
+                emit("read_window.throttled", stats_.throttled.get());
+            });
+    }
+
+    ReadBudget::~ReadBudget()
+    {
+        StatsRegistry::get().removeSource(statsId_);
+    }
+
+    ReadBudget &ReadBudget::get(folly::EventBase &evb)
+    {
+        static folly::EventBaseLocal<std::unique_ptr<ReadBudget>> budgets;
+        auto &budget = budgets.try_emplace_with(
+            evb,
+            []
+            {
+                return std::make_unique<ReadBudget>(
+                    size_t(FLAGS_static_file_worker_inflight_mb) << 20);
+            });
+        return *budget;
+    }
+
+    bool ReadBudget::reserve(size_t n, bool force)
+    {
+        if (!force && inflight_ + n > limit_)
+        {
+            stats_.throttled.add();
+            return false;
+        }
+        inflight_ += n;
+        stats_.inflightBytes.set(inflight_);
+        return true;
+    }
+
+    void ReadBudget::release(size_t n)
+    {
+        DCHECK_GE(inflight_, n);
+        inflight_ -= n;
+        stats_.inflightBytes.set(inflight_);
+    }
+
+    ReadWindow::ReadWindow(uint64_t fileSize)
+        : adaptive_(FLAGS_static_file_read_policy != "fixed"),
+          async_(FLAGS_static_file_read_async),
+          minBlock_(size_t(FLAGS_static_file_min_block_kb) << 10),
+          maxBlock_(std::max(minBlock_, size_t(FLAGS_static_file_max_block_kb) << 10)),
+          maxWindow_(size_t(FLAGS_static_file_max_window_kb) << 10)
+    {
+        if (!adaptive_)
+        {
+            block_ = minBlock_;
+            window_ = kFixedBlocks * block_;
+            return;
+        }
+        // Until there is a rate, about 64 reads per file
+        block_ = clampPow2(fileSize / 64, minBlock_, maxBlock_);
+        resize();
+    }
+
+    void ReadWindow::resize()
+    {
+        if (bytesPerSec_ > 0)
+        {
+            block_ = clampPow2(size_t(bytesPerSec_ * kBlockSeconds), minBlock_, maxBlock_);
+        }
+        // Without a capacity sample keep a few blocks going
+        size_t want = capacity_ ? capacity_ : kSampleBlocks * block_;
+        window_ = std::clamp<size_t>(want, 2 * block_, std::max(maxWindow_, 2 * block_));
+        if (pausedCap_)
+        {
+            window_ = std::min(window_, pausedCap_);
+        }
+    }
+
+    void ReadWindow::update(proxygen::HTTPTransaction &txn)
+    {
+        if (!adaptive_)
+        {
+            return;
+        }
+        auto now = Clock::now();
+        if (now - lastUpdate_ < kUpdateInterval)
+        {
+            return;
+        }
+        lastUpdate_ = now;
+
+        size_t capacity = 0;
+        proxygen::HTTPTransaction::FlowControlInfo fc;
+        txn.getCurrentFlowControlInfo(&fc);
+        if (fc.flowControlEnabled_ && fc.streamSendWindow_ >= 0)
+        {
+            capacity = size_t(std::max<int64_t>(
+                fc.streamSendWindow_ - std::max<int64_t>(fc.streamSendOutstanding_, 0), 0));
+        }
+        wangle::TransportInfo tinfo;
+        if (txn.getCurrentTransportInfo(&tinfo) && tinfo.cwnd > 0 && tinfo.mss > 0)
+        {
+            size_t cwndBytes = size_t(tinfo.cwnd) * size_t(tinfo.mss);
+            capacity = capacity ? std::min(capacity, cwndBytes) : cwndBytes;
+        }
+        capacity_ = capacity;
+        resize();
+    }
+
+    void ReadWindow::onReadComplete(size_t bytes)
+    {
+        if (!adaptive_)
+        {
+            return;
+        }
+        auto now = Clock::now();
+        if (sampleBytes_ == 0)
+        {
+            sampleStart_ = now;
+        }
+        sampleBytes_ += bytes;
+        if (sampleBytes_ < kSampleBlocks * block_)
+        {
+            return;
+        }
+        double secs = std::chrono::duration<double>(now - sampleStart_).count();
+        if (secs > 0)
+        {
+            double rate = sampleBytes_ / secs;
+            bytesPerSec_ = bytesPerSec_ > 0
+                               ? bytesPerSec_ + kRateWeight * (rate - bytesPerSec_)
+                               : rate;
+            resize();
+        }
+        sampleBytes_ = 0;
+    }
+
+    void ReadWindow::onEgressPaused()
+    {
+        if (!adaptive_)
+        {
+            return;
+        }
+        // The read rate says nothing about the send rate: keep the block
+        // size and cut the bytes in flight
+        pausedCap_ = std::max(window_ / 2, block_);
+        window_ = pausedCap_;
+    }
+
+    void ReadWindow::onEgressResumed()
+    {
+        if (!adaptive_ || !pausedCap_)
+        {
+            return;
+        }
+        pausedCap_ = 0;
+        resize();
+    }
+
+} // namespace quic::samples
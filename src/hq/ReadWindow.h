@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include <folly/io/async/EventBase.h>
+#include <proxygen/lib/http/session/HTTPTransaction.h>
+
+#include "ServerStats.h"
+
+namespace quic::samples
+{
+    /*
+     * Per event base cap on the file bytes that all transactions of a worker
+     * have submitted but not yet seen completed. Keeps a burst of large
+     * downloads from pinning unbounded read buffers.
+     */
+    class ReadBudget
+    {
+    public:
+        explicit ReadBudget(size_t limit);
+        ~ReadBudget();
+
+        static ReadBudget &get(folly::EventBase &evb);
+
+        // Takes n bytes from the budget. force lets a transaction with nothing
+        // in flight make progress even when the worker is over its limit.
+        bool reserve(size_t n, bool force);
+
+        void release(size_t n);
+
+    private:
+        size_t limit_;
+        size_t inflight_{0};
+
+        struct Stats
+        {
+            WorkerCounter inflightBytes;
+            WorkerCounter throttled;
+        };
+        Stats stats_;
+        uint64_t statsId_{0};
+    };
+
+    /*
+     * Read-ahead policy of one streamed file.
+     *
+     * The block size starts from the file size and then follows the measured
+     * read throughput, so that a block is roughly a millisecond of data: slow
+     * or small transfers keep small blocks, fast large ones grow towards
+     * --static_file_max_block_kb. The window, the bytes the transaction may
+     * have in flight, follows what the transport can take right now: the
+     * stream's flow-control credit and the congestion window, bounded by
+     * --static_file_max_window_kb. While the transport has paused egress the
+     * window is halved on every pause, down to one block, and grows back
+     * from capacity samples once egress resumes. The fixed policy keeps the
+     * historical 32 reads of --static_file_min_block_kb for comparison.
+     */
+    class ReadWindow
+    {
+    public:
+        explicit ReadWindow(uint64_t fileSize);
+
+        size_t blockSize() const { return block_; }
+
+        size_t windowBytes() const { return window_; }
+
+        // Whether reads are submitted with IOSQE_ASYNC
+        bool asyncReads() const { return async_; }
+
+        // Samples the transaction's send capacity, at most every few ms
+        void update(proxygen::HTTPTransaction &txn);
+
+        void onReadComplete(size_t bytes);
+
+        // The transport is the bottleneck: shrink the window until it drains
+        void onEgressPaused();
+
+        void onEgressResumed();
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        void resize();
+
+        bool adaptive_;
+        bool async_;
+        size_t minBlock_;
+        size_t maxBlock_;
+        size_t maxWindow_;
+        size_t block_;
+        size_t window_;
+        // Unknown until the first update
+        size_t capacity_{0};
+        // Window cap while egress is paused, 0 when it is not
+        size_t pausedCap_{0};
+        double bytesPerSec_{0};
+        size_t sampleBytes_{0};
+        Clock::time_point sampleStart_;
+        Clock::time_point lastUpdate_;
+    };
+
+} // namespace quic::samples
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ResponseHeaders.h"
+
+#include <algorithm>
+
+#include <folly/io/async/EventBaseLocal.h>
+#include <folly/portability/GFlags.h>
+
+DEFINE_uint32(static_header_cache_entries,
+              8192,
+              "Prebuilt static response header sets kept per worker");
+
+namespace quic::samples
+{
+    HeaderTemplateCache::HeaderTemplateCache(size_t maxEntries)
+        : entries_(std::max<size_t>(maxEntries, 1))
+    {
+        statsId_ = StatsRegistry::get().addSource(
+            [this](StatsRegistry::Emit emit)
+            {
+                emit("header_templates.hits", stats_.hits.get());
+                emit("header_templates.misses", stats_.misses.get());
+            });
+    }
+
+    HeaderTemplateCache::~HeaderTemplateCache()
+    {
+        StatsRegistry::get().removeSource(statsId_);
+    }
+
+    HeaderTemplateCache &HeaderTemplateCache::get(folly::EventBase &evb)
+    {
+        static folly::EventBaseLocal<std::unique_ptr<HeaderTemplateCache>> caches;
+        auto &cache = caches.try_emplace_with(
+            evb,
+            [] { return std::make_unique<HeaderTemplateCache>(FLAGS_static_header_cache_entries); });
+        return *cache;
+    }
+
+    std::shared_ptr<const HeaderTemplate> HeaderTemplateCache::lookup(
+        const std::shared_ptr<const CachedFile> &file,
+        ContentCoding coding,
+        uint64_t length,
+        bool sidecars,
+        folly::FunctionRef<void(HeaderTemplate &)> build)
+    {
+        Key key{file.get(), coding, length, sidecars};
+        auto it = entries_.find(key);
+        if (it != entries_.end() && !it->second.file.expired())
+        {
+            stats_.hits.add();
+            return it->second.headers;
+        }
+        stats_.misses.add();
+        auto headers = std::make_shared<HeaderTemplate>();
+        build(*headers);
+        entries_.set(key, Entry{file, headers});
+        return headers;
+    }
+
+    DateHeader &DateHeader::get(folly::EventBase &evb)
+    {
+        static folly::EventBaseLocal<DateHeader> dates;
+        return dates.try_emplace(evb);
+    }
+
+    const std::string &DateHeader::now()
+    {
+        auto second = ::time(nullptr);
+        if (second != second_)
+        {
+            second_ = second;
+            value_ = formatHttpDate(second);
+        }
+        return value_;
+    }
+
+} // namespace quic::samples
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <ctime>
+#include <memory>
+#include <string>
+
+#include <folly/Function.h>
+#include <folly/container/EvictingCacheMap.h>
+#include <folly/hash/Hash.h>
+#include <folly/io/async/EventBase.h>
+#include <proxygen/lib/http/HTTPHeaders.h>
+
+#include "FileCache.h"
+#include "ServerStats.h"
+#include "StaticFileHttp.h"
+
+namespace quic::samples
+{
+    /*
+     * Response headers of one version of one asset in one coding, formatted
+     * once. The handler copies a prebuilt set into the response instead of
+     * formatting sizes, dates and entity tags per request.
+     */
+    struct HeaderTemplate
+    {
+        // Entity tag of the representation
+        std::string etag;
+        // ETag, Last-Modified, Content-Encoding, Vary and Alt-Svc: what a
+        // 304 or 412 carries
+        proxygen::HTTPHeaders validators;
+        // validators plus Content-Type, and Content-Length and
+        // Accept-Ranges unless the length is unknown: a full 200
+        proxygen::HTTPHeaders full;
+    };
+
+    /*
+     * Per event base cache of HeaderTemplates, keyed by cached file, coding,
+     * body length and whether the route negotiates sidecars (Vary), bounded
+     * in entries with LRU eviction. A CachedFile is
+     * immutable and replaced when the file changes, so its identity names
+     * the asset version; entries hold a weak reference to tell a live file
+     * from a new one at a reused address.
+     */
+    class HeaderTemplateCache
+    {
+    public:
+        static constexpr uint64_t kUnknownLength = UINT64_MAX;
+
+        explicit HeaderTemplateCache(size_t maxEntries);
+        ~HeaderTemplateCache();
+
+        static HeaderTemplateCache &get(folly::EventBase &evb);
+
+        // Returns the template, calling build to fill a new one on a miss
+        std::shared_ptr<const HeaderTemplate> lookup(
+            const std::shared_ptr<const CachedFile> &file,
+            ContentCoding coding,
+            uint64_t length,
+            bool sidecars,
+            folly::FunctionRef<void(HeaderTemplate &)> build);
+
+    private:
+        struct Key
+        {
+            const CachedFile *file;
+            ContentCoding coding;
+            uint64_t length;
+            // A reload can flip --static_sidecars and with it Vary
+            bool sidecars;
+
+            bool operator==(const Key &other) const
+            {
+                return file == other.file && coding == other.coding && length == other.length &&
+                       sidecars == other.sidecars;
+            }
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key &key) const
+            {
+                return folly::hash::hash_combine(
+                    key.file, static_cast<int>(key.coding), key.length, key.sidecars);
+            }
+        };
+
+        struct Entry
+        {
+            std::weak_ptr<const CachedFile> file;
+            std::shared_ptr<const HeaderTemplate> headers;
+        };
+
+        folly::EvictingCacheMap<Key, Entry, KeyHash> entries_;
+
+        struct Stats
+        {
+            WorkerCounter hits;
+            WorkerCounter misses;
+        };
+        Stats stats_;
+        uint64_t statsId_{0};
+    };
+
+    /*
+     * Per event base Date header value, formatted at most once a second.
+     */
+    class DateHeader
+    {
+    public:
+        static DateHeader &get(folly::EventBase &evb);
+
+        const std::string &now();
+
+    private:
+        time_t second_{0};
+        std::string value_;
+    };
+
+} // namespace quic::samples
@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "RouteTable.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <folly/Conv.h>
+#include <folly/lang/Bits.h>
+#include <glog/logging.h>
+
+namespace
+{
+    // FNV-1a folded with a seed; constexpr so patterns known at compile time
+    // could be hashed by the compiler
+    constexpr uint64_t routeHash(std::string_view key, uint64_t seed)
+    {
+        uint64_t h = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+        for (char c : key)
+        {
+            h ^= static_cast<unsigned char>(c);
+            h *= 0x100000001b3ULL;
+        }
+        return h ^ (h >> 29);
+    }
+    static_assert(routeHash("/status", 0) != routeHash("/status", 1), "seed must matter");
+    static_assert(routeHash("/status", 0) != routeHash("/statuz", 0), "hash must mix");
+
+    // Seeds tried per table size before the table doubles
+    constexpr uint64_t kSeedAttempts = 64;
+
+    size_t commonPrefix(folly::StringPiece a, folly::StringPiece b)
+    {
+        size_t n = std::min(a.size(), b.size());
+        size_t i = 0;
+        while (i < n && a[i] == b[i])
+        {
+            ++i;
+        }
+        return i;
+    }
+
+    bool isExact(folly::StringPiece pattern)
+    {
+        return pattern.find(':') == folly::StringPiece::npos && !pattern.endsWith('*');
+    }
+}
+
+namespace quic::samples
+{
+    folly::StringPiece RouteMatch::param(folly::StringPiece name) const
+    {
+        for (const auto &[key, value] : params)
+        {
+            if (key == name)
+            {
+                return value;
+            }
+        }
+        return {};
+    }
+
+    struct RouteTable::Node
+    {
+        // Bytes on the edge from the parent; empty for a capture node
+        std::string label;
+        std::vector<std::unique_ptr<Node>> children;
+        // Matches one non-empty segment, up to the next '/'
+        std::unique_ptr<Node> capture;
+        std::string captureName;
+        // Route whose pattern ends here, and route matching anything below
+        int32_t exact{-1};
+        int32_t prefix{-1};
+    };
+
+    RouteTable::RouteTable(std::vector<Route> routes, Route fallback)
+        : routes_(std::move(routes)), fallback_(std::move(fallback)), root_(std::make_unique<Node>())
+    {
+        if (!fallback_.factory)
+        {
+            throw std::invalid_argument("route table needs a fallback factory");
+        }
+        for (size_t i = 0; i < routes_.size(); ++i)
+        {
+            const auto &pattern = routes_[i].pattern;
+            if (pattern.empty() || pattern[0] != '/' || !routes_[i].factory)
+            {
+                throw std::invalid_argument(
+                    folly::to<std::string>("bad route '", pattern, "'"));
+            }
+            if (isExact(pattern))
+            {
+                addExact(i);
+            }
+            else
+            {
+                addTrie(i);
+            }
+        }
+        buildExactIndex();
+    }
+
+    RouteTable::~RouteTable() = default;
+
+    void RouteTable::addExact(size_t idx)
+    {
+        std::string_view pattern = routes_[idx].pattern;
+        for (const auto &entry : exact_)
+        {
+            if (entry.first == pattern)
+            {
+                throw std::invalid_argument(
+                    folly::to<std::string>("duplicate route '", pattern, "'"));
+            }
+        }
+        exact_.emplace_back(pattern, idx);
+    }
+
+    void RouteTable::addTrie(size_t idx)
+    {
+        folly::StringPiece rest = routes_[idx].pattern;
+        bool isPrefix = rest.endsWith('*');
+        if (isPrefix)
+        {
+            rest.pop_back();
+        }
+        Node *node = root_.get();
+        while (!rest.empty())
+        {
+            if (rest.front() == ':')
+            {
+                auto end = std::min(rest.find('/'), rest.size());
+                auto name = rest.subpiece(1, end - 1);
+                if (name.empty() || name.contains('*'))
+                {
+                    throw std::invalid_argument(
+                        folly::to<std::string>("bad capture in route '", routes_[idx].pattern, "'"));
+                }
+                if (!node->capture)
+                {
+                    node->capture = std::make_unique<Node>();
+                    node->captureName = name.str();
+                }
+                else if (node->captureName != name)
+                {
+                    throw std::invalid_argument(folly::to<std::string>(
+                        "route '", routes_[idx].pattern, "' renames capture ':", node->captureName, "'"));
+                }
+                node = node->capture.get();
+                rest.advance(end);
+                continue;
+            }
+            // Static bytes up to the next capture, split into the radix edges
+            auto run = rest.subpiece(0, std::min(rest.find(':'), rest.size()));
+            rest.advance(run.size());
+            while (!run.empty())
+            {
+                auto it = std::find_if(node->children.begin(),
+                                       node->children.end(),
+                                       [&](const auto &child) { return child->label[0] == run[0]; });
+                if (it == node->children.end())
+                {
+                    auto child = std::make_unique<Node>();
+                    child->label = run.str();
+                    node->children.push_back(std::move(child));
+                    node = node->children.back().get();
+                    break;
+                }
+                auto &child = *it;
+                size_t common = commonPrefix(child->label, run);
+                if (common < child->label.size())
+                {
+                    // The new route diverges inside the edge: split it
+                    auto mid = std::make_unique<Node>();
+                    mid->label = child->label.substr(0, common);
+                    child->label.erase(0, common);
+                    mid->children.push_back(std::move(child));
+                    child = std::move(mid);
+                }
+                node = child.get();
+                run.advance(common);
+            }
+        }
+        auto &slot = isPrefix ? node->prefix : node->exact;
+        if (slot >= 0)
+        {
+            throw std::invalid_argument(
+                folly::to<std::string>("duplicate route '", routes_[idx].pattern, "'"));
+        }
+        slot = static_cast<int32_t>(idx);
+    }
+
+    void RouteTable::buildExactIndex()
+    {
+        if (exact_.empty())
+        {
+            return;
+        }
+        // Look for a seed that puts every key in its own slot; a load factor
+        // of at most one half makes that quick
+        size_t size = folly::nextPowTwo(exact_.size() * 2);
+        for (;;)
+        {
+            for (uint64_t seed = 0; seed < kSeedAttempts; ++seed)
+            {
+                slots_.assign(size, -1);
+                bool collided = false;
+                for (size_t i = 0; i < exact_.size() && !collided; ++i)
+                {
+                    auto &slot = slots_[routeHash(exact_[i].first, seed) & (size - 1)];
+                    collided = slot >= 0;
+                    slot = static_cast<int32_t>(i);
+                }
+                if (!collided)
+                {
+                    seed_ = seed;
+                    VLOG(2) << "Route table: " << exact_.size() << " exact routes in " << size
+                            << " slots, seed " << seed;
+                    return;
+                }
+            }
+            size *= 2;
+        }
+    }
+
+    bool RouteTable::search(const Node &node, folly::StringPiece rest, RouteMatch &match) const
+    {
+        if (rest.empty() && node.exact >= 0)
+        {
+            match.route = &routes_[node.exact];
+            return true;
+        }
+        if (!rest.empty())
+        {
+            // Edges of a node start with distinct bytes
+            for (const auto &child : node.children)
+            {
+                if (child->label[0] == rest[0])
+                {
+                    if (rest.startsWith(child->label) &&
+                        search(*child, rest.subpiece(child->label.size()), match))
+                    {
+                        return true;
+                    }
+                    break;
+                }
+            }
+        }
+        if (node.capture)
+        {
+            auto end = std::min(rest.find('/'), rest.size());
+            if (end > 0)
+            {
+                match.params.emplace_back(node.captureName, rest.subpiece(0, end));
+                if (search(*node.capture, rest.subpiece(end), match))
+                {
+                    return true;
+                }
+                match.params.pop_back();
+            }
+        }
+        if (node.prefix >= 0)
+        {
+            match.route = &routes_[node.prefix];
+            return true;
+        }
+        return false;
+    }
+
+    RouteMatch RouteTable::match(folly::StringPiece path) const
+    {
+        RouteMatch match;
+        if (!slots_.empty())
+        {
+            std::string_view key(path.data(), path.size());
+            auto slot = slots_[routeHash(key, seed_) & (slots_.size() - 1)];
+            if (slot >= 0 && exact_[slot].first == key)
+            {
+                match.route = &routes_[exact_[slot].second];
+                return match;
+            }
+        }
+        if (!search(*root_, path, match))
+        {
+            match.route = &fallback_;
+        }
+        return match;
+    }
+
+} // namespace quic::samples
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <folly/Range.h>
+#include <proxygen/lib/http/HTTPMessage.h>
+
+namespace quic::samples
+{
+    class BaseSampleHandler;
+
+    // Per route knobs applied to the handlers a route creates
+    struct RouteOptions
+    {
+        // Transaction idle timeout, zero keeps the session default
+        std::chrono::milliseconds timeout{0};
+        // Per connection download rate limit (KB/s) of static files on the
+        // route, used where no --static_rate_limits rule matches. 0: none
+        uint64_t rateKbps{0};
+        // Cache-Control sent with static files, empty to send none
+        std::string cacheControl;
+    };
+
+    struct RouteMatch;
+
+    using RouteFactory =
+        std::function<BaseSampleHandler *(proxygen::HTTPMessage &, const RouteMatch &)>;
+
+    /*
+     * One entry of a route table. The pattern says how it matches:
+     *
+     *     /status          exact path
+     *     /delay*          any path starting with /delay
+     *     /files/:id       /files/ and one path segment, captured as id
+     *     /u/:user/pub/*   captures followed by any rest
+     */
+    struct Route
+    {
+        std::string pattern;
+        RouteFactory factory;
+        RouteOptions options;
+    };
+
+    struct RouteMatch
+    {
+        const Route *route{nullptr};
+        // Captured segments, views into the route pattern and the path
+        std::vector<std::pair<folly::StringPiece, folly::StringPiece>> params;
+
+        // Empty if the route has no such capture
+        folly::StringPiece param(folly::StringPiece name) const;
+    };
+
+    /*
+     * Routes compiled for lookup by request path.
+     *
+     * Exact routes sit in a perfect hash table searched for when the table
+     * is built, so they cost one hash and one compare. Prefix and
+     * parameterized routes go into a radix trie walked once per request:
+     * an exact pattern ending at the path beats a longer prefix, static
+     * edges beat captures, and the longest matching prefix wins. What
+     * nothing matches goes to the fallback route.
+     *
+     * Construction throws std::invalid_argument for a malformed or
+     * duplicate pattern. A built table is immutable and may be shared
+     * between threads.
+     */
+    class RouteTable
+    {
+    public:
+        RouteTable(std::vector<Route> routes, Route fallback);
+        ~RouteTable();
+
+        RouteTable(const RouteTable &) = delete;
+        RouteTable &operator=(const RouteTable &) = delete;
+
+        // The match for path, the fallback route if nothing else matches.
+        // The views in the result live as long as the table and the path.
+        RouteMatch match(folly::StringPiece path) const;
+
+        size_t size() const { return routes_.size(); }
+
+    private:
+        struct Node;
+
+        void addExact(size_t idx);
+        void addTrie(size_t idx);
+        void buildExactIndex();
+        bool search(const Node &node,
+                    folly::StringPiece rest,
+                    RouteMatch &match) const;
+
+        std::vector<Route> routes_;
+        Route fallback_;
+        std::unique_ptr<Node> root_;
+
+        // Perfect hash of the exact routes: slot -> index into routes_, -1
+        // if empty
+        std::vector<std::pair<std::string_view, size_t>> exact_;
+        std::vector<int32_t> slots_;
+        uint64_t seed_{0};
+    };
+
+} // namespace quic::samples
@@ -8,7 +8,10 @@
 
 #include "SampleHandlers.h"
 
+#include "AssetBundle.h"
 #include "FileRingHandler.h"
+#include "IoUringProfile.h"
+#include "StaticManifest.h"
 #include "WebSocketHandler.h"
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/split.hpp>
@@ -22,70 +25,130 @@ std::atomic<bool> shouldPassHealthChecks{true};
 DEFINE_string(static_root,
               "",
               "Path to serve static files from. Disabled if empty.");
+DEFINE_bool(static_sidecars,
+            true,
+            "Serve precompressed foo.br/.zst/.gz sidecars of static files to "
+            "clients that accept the coding");
+DEFINE_string(static_cache_control,
+              "",
+              "Cache-Control value sent with static files. None if empty.");
+DEFINE_bool(admin_routes,
+            false,
+            "Serve /server_stats and /admin/reload_config to clients on this "
+            "host. Off, the paths are ordinary files.");
 
 namespace quic::samples {
 
 using namespace proxygen;
 
-HTTPTransactionHandler* Dispatcher::getRequestHandler(HTTPMessage* msg) {
-  DCHECK(msg);
-  auto path = msg->getPathAsStringPiece();
-  // if (path == "/" || path == "/echo") {
-  //   return new EchoHandler(params_);
-  // }
-  // if (path == "/continue") {
-  //   return new ContinueHandler(params_);
-  // }
-  // if (path.size() > 1 && path[0] == '/' && std::isdigit(path[1])) {
-  //   return new RandBytesGenHandler(params_);
-  // }
-  if (path == "/status") {
-    return new HealthCheckHandler(shouldPassHealthChecks, params_);
-  }
-  if (path == "/status_ok") {
-    shouldPassHealthChecks = true;
-    return new HealthCheckHandler(true, params_);
-  }
-  if (path == "/status_fail") {
-    shouldPassHealthChecks = false;
-    return new HealthCheckHandler(false, params_);
-  }
-  if (path == "/wss")
-  {
-    return new websockethandler::WebSocketHandler(params_, folly::EventBaseManager::get()->getEventBase());
+Dispatcher::Dispatcher(HandlerParams params) : params_(std::move(params)) {
+  // The builder and the route factories it makes point at this Dispatcher.
+  // The leaked store outlives it, so the builder is dropped again in the
+  // destructor; the servers are stopped before then, so no request reaches
+  // a published factory afterwards.
+  ConfigStore::get().start([this](const ServerConfig& config) {
+    return std::make_shared<const RouteTable>(makeRoutes(config),
+                                              makeFallback());
+  });
+  // Map the bundle now rather than on the first request
+  AssetBundle::start();
+  auto config = ConfigStore::current();
+  if (!config->staticRoot.empty()) {
+    // Index the static files before the first request comes in. A root
+    // changed by a reload is served without the manifest.
+    StaticManifest::start(config->staticRoot);
   }
+}
+
+Dispatcher::~Dispatcher() {
+  ConfigStore::get().stop();
+}
 
-  // if (path == "/wait" || path == "/release") {
-  //   return new WaitReleaseHandler(
-  //       folly::EventBaseManager::get()->getEventBase(), params_);
-  // }
-
-  // if (path == "/post") {
-  //   return new SimplePostHandler(params_);
-  // }
-
-  // if (boost::algorithm::starts_with(path, "/chunked")) {
-  //   return new ChunkedHandler(params_,
-  //                             folly::EventBaseManager::get()->getEventBase());
-  // }
-  // if (boost::algorithm::starts_with(path, "/push")) {
-  //   return new ServerPushHandler(params_);
-  // }
-
-  // if (boost::algorithm::starts_with(path, "/webtransport/devious-baton")) {
-  //   return new DeviousBatonHandler(
-  //       params_, folly::EventBaseManager::get()->getEventBase());
-  // }
-
-  if (!FLAGS_static_root.empty()) {
-    //return new StaticFileHandler(params_, FLAGS_static_root);
-    return new StaticFileUringHandler(params_, FLAGS_static_root);
+std::vector<Route> Dispatcher::makeRoutes(const ServerConfig& config) {
+  // Unused handlers, kept for reference:
+  //   "/", "/echo" -> EchoHandler       "/continue" -> ContinueHandler
+  //   "/wait", "/release" -> WaitReleaseHandler
+  //   "/post" -> SimplePostHandler      "/chunked*" -> ChunkedHandler
+  //   "/push*" -> ServerPushHandler
+  //   "/webtransport/devious-baton*" -> DeviousBatonHandler
+  std::vector<Route> routes{
+      {"/status",
+       [this](HTTPMessage&, const RouteMatch&) -> BaseSampleHandler* {
+         return new HealthCheckHandler(shouldPassHealthChecks, params_);
+       }},
+      {"/status_ok",
+       [this](HTTPMessage&, const RouteMatch&) -> BaseSampleHandler* {
+         shouldPassHealthChecks = true;
+         return new HealthCheckHandler(true, params_);
+       }},
+      {"/status_fail",
+       [this](HTTPMessage&, const RouteMatch&) -> BaseSampleHandler* {
+         shouldPassHealthChecks = false;
+         return new HealthCheckHandler(false, params_);
+       }},
+      {"/wss",
+       [this](HTTPMessage&, const RouteMatch&) -> BaseSampleHandler* {
+         return new websockethandler::WebSocketHandler(
+             params_, folly::EventBaseManager::get()->getEventBase());
+       }},
+  };
+  if (FLAGS_admin_routes) {
+    routes.push_back(
+        {"/server_stats",
+         [this](HTTPMessage&, const RouteMatch&) -> BaseSampleHandler* {
+           return new ServerStatsHandler(params_);
+         }});
+    routes.push_back(
+        {"/admin/reload_config",
+         [this](HTTPMessage&, const RouteMatch&) -> BaseSampleHandler* {
+           return new ConfigReloadHandler(params_);
+         }});
   }
-  if (boost::algorithm::starts_with(path, "/delay")) {
-    return new DelayHandler(params_,
-                            folly::EventBaseManager::get()->getEventBase());
+  if (!config.staticRoot.empty()) {
+    RouteFactory staticFiles =
+        [this, root = config.staticRoot, sidecars = config.staticSidecars](
+            HTTPMessage&, const RouteMatch&) -> BaseSampleHandler* {
+      auto* evb = folly::EventBaseManager::get()->getEventBase();
+      if (!IoUringProfile::usesIoUring(*evb)) {
+        // The worker fell back to epoll: read on the CPU executor
+        return new StaticFileHandler(params_, root);
+      }
+      return new StaticFileUringHandler(params_, root, sidecars);
+    };
+    for (const auto& route : config.routes) {
+      routes.push_back({route.pattern, staticFiles, route.options});
+    }
+    // Everything else is a file
+    RouteOptions options;
+    options.cacheControl = config.staticCacheControl;
+    routes.push_back({"/*", std::move(staticFiles), std::move(options)});
+  } else {
+    routes.push_back(
+        {"/delay*",
+         [this](HTTPMessage&, const RouteMatch&) -> BaseSampleHandler* {
+           return new DelayHandler(
+               params_, folly::EventBaseManager::get()->getEventBase());
+         }});
   }
-  return new DummyHandler(params_);
+  return routes;
+}
+
+Route Dispatcher::makeFallback() {
+  return {"",
+          [this](HTTPMessage&, const RouteMatch&) -> BaseSampleHandler* {
+            return new DummyHandler(params_);
+          }};
+}
+
+HTTPTransactionHandler* Dispatcher::getRequestHandler(HTTPMessage* msg) {
+  DCHECK(msg);
+  // Factories read the config too; the table and the matched route must
+  // outlive them whatever they publish
+  auto config = ConfigStore::current();
+  auto match = config->routeTable->match(msg->getPathAsStringPiece());
+  auto* handler = match.route->factory(*msg, match);
+  handler->setRoute(std::move(config), &match.route->options);
+  return handler;
 }
 
 class WaitReleaseHandler;
@@ -31,7 +31,11 @@
 #include <folly/executors/GlobalExecutor.h>
 #include <folly/io/async/AsyncTimeout.h>
 #include <folly/io/async/EventBaseManager.h>
+#include "BandwidthShaper.h"
 #include "HQServer.h"
+#include "HandlerPool.h"
+#include "ServerConfig.h"
+#include "ServerStats.h"
 //#include "devious/DeviousBaton.h"
 #include <proxygen/lib/http/session/HTTPTransaction.h>
 #include <proxygen/lib/utils/SafePathUtils.h>
@@ -46,21 +50,31 @@ struct HandlerParams {
   std::string protocol;
   uint16_t port;
   std::string httpVersion;
+  // Alt-Svc value advertised on every response, empty if none
+  std::string altSvc;
 
   HandlerParams(std::string pro, uint16_t po, std::string h)
       : protocol(std::move(pro)), port(po), httpVersion(std::move(h)) {
+    if (!protocol.empty() && port != 0) {
+      altSvc = fmt::format("{}=\":{}\"; ma=3600", protocol, port);
+    }
   }
 };
 
 class Dispatcher {
  public:
-  explicit Dispatcher(HandlerParams params) : params_(std::move(params)) {
-  }
+  explicit Dispatcher(HandlerParams params);
+  ~Dispatcher();
 
   proxygen::HTTPTransactionHandler* getRequestHandler(
       proxygen::HTTPMessage* /* msg */);
 
   HandlerParams params_;
+
+ private:
+  // The routes of a config version; see RouteTable for the pattern syntax
+  std::vector<Route> makeRoutes(const ServerConfig& config);
+  Route makeFallback();
 };
 
 using random_bytes_engine =
@@ -77,6 +91,16 @@ class BaseSampleHandler : public proxygen::HTTPTransactionHandler {
 
   void setTransaction(proxygen::HTTPTransaction* txn) noexcept override {
     txn_ = txn;
+    if (route_ && route_->timeout.count() > 0) {
+      txn_->setIdleTimeout(route_->timeout);
+    }
+  }
+
+  // Config version and options of the route that created the handler, set
+  // before the transaction is. The snapshot keeps the options alive.
+  void setRoute(ConfigStore::Snapshot config, const RouteOptions* options) {
+    config_ = std::move(config);
+    route_ = options;
   }
 
   void detachTransaction() noexcept override {
@@ -102,13 +126,23 @@ class BaseSampleHandler : public proxygen::HTTPTransactionHandler {
   void onEgressResumed() noexcept override {
   }
 
+  // Admin handlers answer only clients on this host; anyone else gets a
+  // 403 and the handler ends the response in onEOM
+  bool rejectRemoteClient() {
+    if (txn_->getPeerAddress().isLoopbackAddress()) {
+      return false;
+    }
+    proxygen::HTTPMessage resp = createHttpResponse(403, "Forbidden");
+    maybeAddAltSvcHeader(resp);
+    txn_->sendHeaders(resp);
+    return true;
+  }
+
   void maybeAddAltSvcHeader(proxygen::HTTPMessage& msg) const {
-    if (params_.protocol.empty() || params_.port == 0) {
+    if (params_.altSvc.empty()) {
       return;
     }
-    msg.getHeaders().add(
-        proxygen::HTTP_HEADER_ALT_SVC,
-        fmt::format("{}=\":{}\"; ma=3600", params_.protocol, params_.port));
+    msg.getHeaders().add(proxygen::HTTP_HEADER_ALT_SVC, params_.altSvc);
   }
 
   // clang-format off
@@ -172,6 +206,8 @@ class BaseSampleHandler : public proxygen::HTTPTransactionHandler {
 
   proxygen::HTTPTransaction* txn_{nullptr};
   const HandlerParams& params_;
+  ConfigStore::Snapshot config_;
+  const RouteOptions* route_{nullptr};
 };
 
 /*
@@ -514,7 +550,9 @@ class RandBytesGenHandler : public BaseSampleHandler {
   bool error_{false};
 };
 
-class DummyHandler : public BaseSampleHandler {
+class DummyHandler
+    : public BaseSampleHandler
+    , public PooledHandler<DummyHandler> {
  public:
   explicit DummyHandler(const HandlerParams& params)
       : BaseSampleHandler(params) {
@@ -562,6 +600,7 @@ class DummyHandler : public BaseSampleHandler {
 
 class DelayHandler
     : public BaseSampleHandler
+    , public PooledHandler<DelayHandler>
     , private folly::AsyncTimeout {
  public:
   explicit DelayHandler(const HandlerParams& params, folly::EventBase* evb)
@@ -610,7 +649,9 @@ class DelayHandler
   std::string responseBody_;
 };
 
-class HealthCheckHandler : public BaseSampleHandler {
+class HealthCheckHandler
+    : public BaseSampleHandler
+    , public PooledHandler<HealthCheckHandler> {
  public:
   HealthCheckHandler(bool healthy, const HandlerParams& params)
       : BaseSampleHandler(params), healthy_(healthy) {
@@ -655,6 +696,102 @@ class HealthCheckHandler : public BaseSampleHandler {
   bool healthy_;
 };
 
+/*
+** A handler which dumps the counters collected by the StatsRegistry,
+** one "name value" pair per line, summed across all workers. Routed only
+** with --admin_routes, and only for loopback clients.
+*/
+class ServerStatsHandler
+    : public BaseSampleHandler
+    , public PooledHandler<ServerStatsHandler> {
+ public:
+  explicit ServerStatsHandler(const HandlerParams& params)
+      : BaseSampleHandler(params) {
+  }
+
+  void onHeadersComplete(
+      std::unique_ptr<proxygen::HTTPMessage> msg) noexcept override {
+    VLOG(10) << "ServerStatsHandler::onHeadersComplete";
+    if (rejectRemoteClient()) {
+      return;
+    }
+    proxygen::HTTPMessage resp = createHttpResponse(200, "Ok");
+    resp.setWantsKeepalive(true);
+    resp.getHeaders().add(proxygen::HTTP_HEADER_CONTENT_TYPE, "text/plain");
+    maybeAddAltSvcHeader(resp);
+    txn_->sendHeaders(resp);
+    if (msg->getMethod() == proxygen::HTTPMethod::GET) {
+      std::string body;
+      for (const auto& stat : StatsRegistry::get().collect()) {
+        folly::toAppend(stat.first, " ", stat.second, "\n", &body);
+      }
+      txn_->sendBody(folly::IOBuf::copyBuffer(body));
+    }
+  }
+
+  void onBody(std::unique_ptr<folly::IOBuf> /*chain*/) noexcept override {
+  }
+
+  void onEOM() noexcept override {
+    txn_->sendEOM();
+  }
+
+  void onError(const proxygen::HTTPException& /*error*/) noexcept override {
+    txn_->sendAbort();
+  }
+};
+
+/*
+ * Rereads --config_file and publishes it to every worker. Routed only with
+ * --admin_routes, and only for loopback clients: reading and compiling the
+ * file happens on the worker serving the request, an operator action that
+ * must not be triggerable from outside.
+ */
+class ConfigReloadHandler
+    : public BaseSampleHandler
+    , public PooledHandler<ConfigReloadHandler> {
+ public:
+  explicit ConfigReloadHandler(const HandlerParams& params)
+      : BaseSampleHandler(params) {
+  }
+
+  void onHeadersComplete(
+      std::unique_ptr<proxygen::HTTPMessage> msg) noexcept override {
+    VLOG(10) << "ConfigReloadHandler::onHeadersComplete";
+    if (rejectRemoteClient()) {
+      return;
+    }
+    if (msg->getMethod() != proxygen::HTTPMethod::POST) {
+      proxygen::HTTPMessage resp =
+          createHttpResponse(405, "Method Not Allowed");
+      resp.getHeaders().add(proxygen::HTTP_HEADER_ALLOW, "POST");
+      maybeAddAltSvcHeader(resp);
+      txn_->sendHeaders(resp);
+      return;
+    }
+    auto result = ConfigStore::get().reload();
+    proxygen::HTTPMessage resp = result ? createHttpResponse(200, "Ok")
+                                        : createHttpResponse(400, "Bad Request");
+    resp.getHeaders().add(proxygen::HTTP_HEADER_CONTENT_TYPE, "text/plain");
+    maybeAddAltSvcHeader(resp);
+    txn_->sendHeaders(resp);
+    txn_->sendBody(folly::IOBuf::copyBuffer(
+        result ? folly::to<std::string>("version ", *result, "\n")
+               : folly::to<std::string>(result.error(), "\n")));
+  }
+
+  void onBody(std::unique_ptr<folly::IOBuf> /*chain*/) noexcept override {
+  }
+
+  void onEOM() noexcept override {
+    txn_->sendEOM();
+  }
+
+  void onError(const proxygen::HTTPException& /*error*/) noexcept override {
+    txn_->sendAbort();
+  }
+};
+
 class SimplePostHandler : public BaseSampleHandler {
  public:
   explicit SimplePostHandler(const HandlerParams& params)
@@ -902,11 +1039,13 @@ class StaticFileHandler : public BaseSampleHandler {
     proxygen::HTTPMessage resp = createHttpResponse(200, "Ok");
     maybeAddAltSvcHeader(resp);
     txn_->sendHeaders(resp);
-    // use a CPU executor since read(2) of a file can block
-    folly::getUnsafeMutableGlobalCPUExecutor()->add(
-        std::bind(&StaticFileHandler::readFile,
-                  this,
-                  folly::EventBaseManager::get()->getEventBase()));
+    evb_ = folly::EventBaseManager::get()->getEventBase();
+    if (msg->getMethod() != proxygen::HTTPMethod::HEAD) {
+      // Same limits as the io_uring handler
+      shaping_ = BandwidthShaper::get(*evb_).shape(
+          &txn_->getTransport(), path, route_ ? route_->rateKbps : 0);
+    }
+    scheduleRead();
   }
 
   void onBody(std::unique_ptr<folly::IOBuf> /*chain*/) noexcept override {
@@ -928,19 +1067,52 @@ class StaticFileHandler : public BaseSampleHandler {
   void onEgressResumed() noexcept override {
     VLOG(10) << "StaticFileHandler::onEgressResumed";
     paused_ = false;
-    folly::getUnsafeMutableGlobalCPUExecutor()->add(
-        std::bind(&StaticFileHandler::readFile,
-                  this,
-                  folly::EventBaseManager::get()->getEventBase()));
+    scheduleRead();
   }
 
  private:
-  void readFile(folly::EventBase* evb) {
+  // Bytes a shaped download reads per trip to the CPU executor
+  static constexpr size_t kShapedChunk = 64 << 10;
+
+  // Runs on the event base: hands the next reads to the CPU executor, at
+  // most one shaped chunk once the shaper has tokens for it
+  void scheduleRead() {
+    size_t limit = 0;
+    if (shaping_) {
+      if (shapingTimer_ && shapingTimer_->isScheduled()) {
+        return;
+      }
+      limit = std::min(kShapedChunk, shaping_->maxBlock());
+      auto wait = shaping_->acquire(limit);
+      if (wait > BandwidthShaper::Clock::duration::zero()) {
+        if (!shapingTimer_) {
+          shapingTimer_ = folly::AsyncTimeout::make(
+              *evb_, [this]() noexcept { scheduleRead(); });
+        }
+        shapingTimer_->scheduleTimeout(
+            std::chrono::ceil<std::chrono::milliseconds>(wait));
+        return;
+      }
+    }
+    // use a CPU executor since read(2) of a file can block
+    folly::getUnsafeMutableGlobalCPUExecutor()->add(
+        std::bind(&StaticFileHandler::readFile, this, evb_, limit));
+  }
+
+  // Reads and forwards the file until paused, done or, if limit is not 0,
+  // after limit bytes
+  void readFile(folly::EventBase* evb, size_t limit) {
     folly::IOBufQueue buf;
+    size_t total = 0;
     while (file_ && !paused_) {
+      if (limit && total >= limit) {
+        evb->runInEventBaseThread([this] { scheduleRead(); });
+        break;
+      }
       // read 4k-ish chunks and foward each one to the client
       auto data = buf.preallocate(4096, 4096);
-      auto rc = folly::readNoInt(file_->fd(), data.first, data.second);
+      size_t want = limit ? std::min(data.second, limit - total) : data.second;
+      auto rc = folly::readNoInt(file_->fd(), data.first, want);
       if (rc < 0) {
         // error
         VLOG(4) << "Read error=" << rc;
@@ -961,6 +1133,7 @@ class StaticFileHandler : public BaseSampleHandler {
         break;
       } else {
         VLOG(1) << "Sending to runin:" << rc;
+        total += rc;
         buf.postallocate(rc);
         evb->runInEventBaseThread([this, body = buf.move()]() mutable {
           VLOG(1) << "I am here size:" << body->length();
@@ -982,6 +1155,9 @@ class StaticFileHandler : public BaseSampleHandler {
   std::unique_ptr<folly::File> file_;
   std::atomic<bool> paused_{false};
   std::string staticRoot_;
+  folly::EventBase* evb_{nullptr};
+  std::unique_ptr<BandwidthShaper::Shaping> shaping_;
+  std::unique_ptr<folly::AsyncTimeout> shapingTimer_;
 };
 
 } // namespace quic::samples
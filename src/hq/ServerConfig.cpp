@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ServerConfig.h"
+
+#include <algorithm>
+#include <csignal>
+#include <stdexcept>
+
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/io/async/AsyncSignalHandler.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/json/json.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+
+DEFINE_string(config_file,
+              "",
+              "JSON file of reloadable settings (routes, static root, limits, "
+              "cache sizes, transport knobs) applied over the command line. "
+              "Reread on SIGHUP and /admin/reload_config.");
+
+DECLARE_string(static_root);
+DECLARE_bool(static_sidecars);
+DECLARE_string(static_cache_control);
+DECLARE_string(static_rate_limits);
+DECLARE_uint64(static_conn_rate_kbps);
+DECLARE_uint64(static_object_cache_mb);
+DECLARE_uint64(static_object_max_kb);
+
+namespace
+{
+    using quic::samples::ConfigStore;
+
+    void checkKeys(const folly::dynamic &obj,
+                   folly::StringPiece what,
+                   std::initializer_list<folly::StringPiece> known)
+    {
+        if (!obj.isObject())
+        {
+            throw std::invalid_argument(folly::to<std::string>(what, " must be an object"));
+        }
+        for (const auto &key : obj.keys())
+        {
+            if (std::find(known.begin(), known.end(), key.asString()) == known.end())
+            {
+                throw std::invalid_argument(
+                    folly::to<std::string>("unknown key '", key.asString(), "' in ", what));
+            }
+        }
+    }
+
+    // Non-negative integer member, if present
+    std::optional<uint64_t> getCount(const folly::dynamic &obj, folly::StringPiece key)
+    {
+        auto *value = obj.get_ptr(key);
+        if (!value)
+        {
+            return std::nullopt;
+        }
+        auto n = value->asInt();
+        if (n < 0)
+        {
+            throw std::invalid_argument(folly::to<std::string>("'", key, "' must not be negative"));
+        }
+        return static_cast<uint64_t>(n);
+    }
+
+    template <class T>
+    void setCount(T &field, const folly::dynamic &obj, folly::StringPiece key)
+    {
+        if (auto n = getCount(obj, key))
+        {
+            field = *n;
+        }
+    }
+
+    void setString(std::string &field, const folly::dynamic &obj, folly::StringPiece key)
+    {
+        if (auto *value = obj.get_ptr(key))
+        {
+            field = value->asString();
+        }
+    }
+
+    class ReloadSignalHandler : public folly::AsyncSignalHandler
+    {
+    public:
+        using folly::AsyncSignalHandler::AsyncSignalHandler;
+
+        void signalReceived(int /*signum*/) noexcept override
+        {
+            auto result = ConfigStore::get().reload();
+            if (result)
+            {
+                LOG(INFO) << "Config version " << *result << " published";
+            }
+            else
+            {
+                LOG(ERROR) << "Config reload rejected: " << result.error();
+            }
+        }
+    };
+}
+
+namespace quic::samples
+{
+    ServerConfig ServerConfig::fromFlags()
+    {
+        ServerConfig config;
+        config.staticRoot = FLAGS_static_root;
+        config.staticSidecars = FLAGS_static_sidecars;
+        config.staticCacheControl = FLAGS_static_cache_control;
+        config.rateLimits = FLAGS_static_rate_limits;
+        config.connRateKbps = FLAGS_static_conn_rate_kbps;
+        config.objectCacheMb = FLAGS_static_object_cache_mb;
+        config.objectMaxKb = FLAGS_static_object_max_kb;
+        return config;
+    }
+
+    ServerConfig ServerConfig::parse(folly::StringPiece json, const ServerConfig &base)
+    {
+        auto doc = folly::parseJson(json);
+        checkKeys(doc,
+                  "config",
+                  {"static_root", "static_sidecars", "static_cache_control", "routes", "limits",
+                   "cache", "transport"});
+        ServerConfig config = base;
+        config.routeTable.reset();
+        setString(config.staticRoot, doc, "static_root");
+        if (auto *sidecars = doc.get_ptr("static_sidecars"))
+        {
+            config.staticSidecars = sidecars->asBool();
+        }
+        setString(config.staticCacheControl, doc, "static_cache_control");
+        if (auto *routes = doc.get_ptr("routes"))
+        {
+            if (!routes->isArray())
+            {
+                throw std::invalid_argument("routes must be an array");
+            }
+            config.routes.clear();
+            for (const auto &route : *routes)
+            {
+                checkKeys(route, "route", {"path", "timeout_ms", "rate_kbps", "cache_control"});
+                RouteConfig parsed;
+                parsed.pattern = route.at("path").asString();
+                if (auto timeout = getCount(route, "timeout_ms"))
+                {
+                    parsed.options.timeout = std::chrono::milliseconds(*timeout);
+                }
+                setCount(parsed.options.rateKbps, route, "rate_kbps");
+                parsed.options.cacheControl = config.staticCacheControl;
+                setString(parsed.options.cacheControl, route, "cache_control");
+                config.routes.push_back(std::move(parsed));
+            }
+        }
+        if (auto *limits = doc.get_ptr("limits"))
+        {
+            checkKeys(*limits, "limits", {"rate_limits", "conn_rate_kbps"});
+            setString(config.rateLimits, *limits, "rate_limits");
+            setCount(config.connRateKbps, *limits, "conn_rate_kbps");
+        }
+        if (auto *cache = doc.get_ptr("cache"))
+        {
+            checkKeys(*cache, "cache", {"object_cache_mb", "object_max_kb"});
+            setCount(config.objectCacheMb, *cache, "object_cache_mb");
+            setCount(config.objectMaxKb, *cache, "object_max_kb");
+        }
+        if (auto *transport = doc.get_ptr("transport"))
+        {
+            checkKeys(*transport,
+                      "transport",
+                      {"conn_flow_control_window", "stream_flow_control_window",
+                       "max_bidi_streams", "idle_timeout_ms"});
+            auto &t = config.transport;
+            t.connFlowControlWindow = getCount(*transport, "conn_flow_control_window");
+            t.streamFlowControlWindow = getCount(*transport, "stream_flow_control_window");
+            t.maxBidiStreams = getCount(*transport, "max_bidi_streams");
+            if (auto timeout = getCount(*transport, "idle_timeout_ms"))
+            {
+                t.idleTimeout = std::chrono::milliseconds(*timeout);
+            }
+        }
+        return config;
+    }
+
+    ConfigStore &ConfigStore::get()
+    {
+        // Never destroyed: workers may read it while the process exits
+        static auto *store = new ConfigStore();
+        return *store;
+    }
+
+    ServerConfig ConfigStore::load() const
+    {
+        auto config = ServerConfig::fromFlags();
+        if (!FLAGS_config_file.empty())
+        {
+            std::string json;
+            if (!folly::readFile(FLAGS_config_file.c_str(), json))
+            {
+                throw std::runtime_error(folly::to<std::string>(
+                    "cannot read ", FLAGS_config_file, ": ", folly::errnoStr(errno)));
+            }
+            config = ServerConfig::parse(json, config);
+        }
+        // Also validates the routes: a bad pattern throws
+        config.routeTable = builder_(config);
+        return config;
+    }
+
+    void ConfigStore::start(RouteBuilder builder)
+    {
+        std::lock_guard<std::mutex> guard(reloadMutex_);
+        CHECK(!builder_) << "ConfigStore started twice";
+        builder_ = std::move(builder);
+        try
+        {
+            publish(load());
+        }
+        catch (const std::exception &ex)
+        {
+            LOG(FATAL) << "Invalid config " << FLAGS_config_file << ": " << ex.what();
+        }
+        if (FLAGS_config_file.empty())
+        {
+            return;
+        }
+        // Leaked with the store
+        auto *thread = new folly::ScopedEventBaseThread("ConfigReload");
+        thread->getEventBase()->runInEventBaseThreadAndWait(
+            [evb = thread->getEventBase()]
+            {
+                auto *handler = new ReloadSignalHandler(evb);
+                handler->registerSignalHandler(SIGHUP);
+            });
+    }
+
+    void ConfigStore::stop()
+    {
+        std::lock_guard<std::mutex> guard(reloadMutex_);
+        builder_ = nullptr;
+    }
+
+    folly::Expected<uint64_t, std::string> ConfigStore::reload()
+    {
+        std::lock_guard<std::mutex> guard(reloadMutex_);
+        if (!builder_)
+        {
+            return folly::makeUnexpected(std::string("server not running"));
+        }
+        if (FLAGS_config_file.empty())
+        {
+            return folly::makeUnexpected(std::string("no --config_file"));
+        }
+        try
+        {
+            publish(load());
+        }
+        catch (const std::exception &ex)
+        {
+            return folly::makeUnexpected(std::string(ex.what()));
+        }
+        return version_.load(std::memory_order_relaxed);
+    }
+
+    void ConfigStore::publish(ServerConfig config)
+    {
+        config.version = version_.load(std::memory_order_relaxed) + 1;
+        auto snapshot = std::make_shared<const ServerConfig>(std::move(config));
+        auto version = snapshot->version;
+        // Readers that see the new version find the snapshot published
+        *config_.wlock() = std::move(snapshot);
+        version_.store(version, std::memory_order_release);
+    }
+
+    ConfigStore::Snapshot ConfigStore::current()
+    {
+        struct Cache
+        {
+            uint64_t version{0};
+            Snapshot config;
+        };
+        static thread_local Cache cache;
+        auto &store = get();
+        if (store.version_.load(std::memory_order_acquire) != cache.version)
+        {
+            cache.config = *store.config_.rlock();
+            cache.version = cache.config->version;
+        }
+        DCHECK(cache.config) << "ConfigStore::start not called";
+        return cache.config;
+    }
+
+} // namespace quic::samples
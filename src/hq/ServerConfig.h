@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <folly/Expected.h>
+#include <folly/Range.h>
+#include <folly/Synchronized.h>
+
+#include "RouteTable.h"
+
+namespace quic::samples
+{
+    // A static file route declared in the config file
+    struct RouteConfig
+    {
+        std::string pattern;
+        RouteOptions options;
+    };
+
+    // Transport knobs for new QUIC connections; unset ones keep the
+    // command line value
+    struct TransportConfig
+    {
+        std::optional<uint64_t> connFlowControlWindow;
+        std::optional<uint64_t> streamFlowControlWindow;
+        std::optional<uint64_t> maxBidiStreams;
+        std::optional<std::chrono::milliseconds> idleTimeout;
+    };
+
+    /*
+     * One immutable version of the reloadable server settings.
+     *
+     * The first version comes from the command line, or from --config_file
+     * over it. A config file is JSON; every key is optional and falls back
+     * to the command line:
+     *
+     *     {
+     *       "static_root": "/srv/www",
+     *       "static_cache_control": "max-age=60",
+     *       "routes": [
+     *         {"path": "/iso/*", "timeout_ms": 600000, "rate_kbps": 512,
+     *          "cache_control": "no-store"}
+     *       ],
+     *       "limits": {"rate_limits": "/updates/=2048:51200",
+     *                  "conn_rate_kbps": 0},
+     *       "cache": {"object_cache_mb": 256, "object_max_kb": 1024},
+     *       "transport": {"conn_flow_control_window": 16777216,
+     *                     "stream_flow_control_window": 1048576,
+     *                     "max_bidi_streams": 100, "idle_timeout_ms": 60000}
+     *     }
+     *
+     * Routes serve static files under the given options and take precedence
+     * over the catch-all file route.
+     */
+    struct ServerConfig
+    {
+        uint64_t version{0};
+        std::string staticRoot;
+        bool staticSidecars{true};
+        std::string staticCacheControl;
+        std::vector<RouteConfig> routes;
+        std::string rateLimits;
+        uint64_t connRateKbps{0};
+        uint64_t objectCacheMb{0};
+        uint64_t objectMaxKb{0};
+        TransportConfig transport;
+        // Compiled by ConfigStore's route builder; owns the RouteOptions
+        // the handlers of this version point at
+        std::shared_ptr<const RouteTable> routeTable;
+
+        static ServerConfig fromFlags();
+
+        // Applies the JSON document over base; throws on malformed input
+        static ServerConfig parse(folly::StringPiece json, const ServerConfig &base);
+    };
+
+    /*
+     * Process wide publication of ServerConfig versions.
+     *
+     * A reload (SIGHUP or reload()) parses --config_file, compiles its
+     * routes and publishes the result; anything invalid leaves the running
+     * version in place. Each thread caches the version it last saw, so
+     * current() costs one atomic load and a reference count increment
+     * until the next publication. A request
+     * holding a snapshot keeps it for its lifetime, whatever is published
+     * meanwhile.
+     */
+    class ConfigStore
+    {
+    public:
+        using Snapshot = std::shared_ptr<const ServerConfig>;
+        using RouteBuilder = std::function<std::shared_ptr<const RouteTable>(const ServerConfig &)>;
+
+        static ConfigStore &get();
+
+        // Publishes the first version and starts listening for SIGHUP.
+        // Exits if --config_file is set but invalid.
+        void start(RouteBuilder builder);
+
+        // Drops the builder: later reloads are rejected. The owner of the
+        // state the builder captured calls it before that state goes away.
+        void stop();
+
+        // Rereads --config_file; the new version, or why it was rejected
+        folly::Expected<uint64_t, std::string> reload();
+
+        // This thread's view of the newest version. Returned by value: a
+        // later call on this thread may replace the cached snapshot, so a
+        // caller that reaches code reading the config holds its own.
+        static Snapshot current();
+
+    private:
+        ConfigStore() = default;
+
+        ServerConfig load() const;
+        void publish(ServerConfig config);
+
+        std::atomic<uint64_t> version_{0};
+        folly::Synchronized<Snapshot> config_;
+        // Serializes reloads
+        std::mutex reloadMutex_;
+        RouteBuilder builder_;
+    };
+
+} // namespace quic::samples
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ServerStats.h"
+
+namespace quic::samples
+{
+    StatsRegistry &StatsRegistry::get()
+    {
+        static StatsRegistry registry;
+        return registry;
+    }
+
+    uint64_t StatsRegistry::addSource(Source source)
+    {
+        auto locked = sources_.wlock();
+        auto id = locked->nextId++;
+        locked->sources.emplace(id, std::move(source));
+        return id;
+    }
+
+    void StatsRegistry::removeSource(uint64_t id)
+    {
+        sources_.wlock()->sources.erase(id);
+    }
+
+    std::map<std::string, uint64_t> StatsRegistry::collect() const
+    {
+        std::map<std::string, uint64_t> result;
+        auto locked = sources_.rlock();
+        for (auto &source : locked->sources)
+        {
+            source.second([&result](folly::StringPiece name, uint64_t value)
+                          { result[name.str()] += value; });
+        }
+        return result;
+    }
+
+} // namespace quic::samples
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+
+#include <folly/Function.h>
+#include <folly/Range.h>
+#include <folly/Synchronized.h>
+
+namespace quic::samples
+{
+    /*
+     * Counter owned by a single worker thread. Only the owner writes it, so
+     * an increment is a plain relaxed load/store pair; any thread may read it
+     * when the stats are collected.
+     */
+    class WorkerCounter
+    {
+    public:
+        void add(uint64_t n = 1)
+        {
+            value_.store(value_.load(std::memory_order_relaxed) + n,
+                         std::memory_order_relaxed);
+        }
+
+        void sub(uint64_t n = 1)
+        {
+            value_.store(value_.load(std::memory_order_relaxed) - n,
+                         std::memory_order_relaxed);
+        }
+
+        void set(uint64_t n) { value_.store(n, std::memory_order_relaxed); }
+
+        uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> value_{0};
+    };
+
+    /*
+     * Process wide list of stats sources. Per-worker components register a
+     * source when they are created and remove it when destroyed; collecting
+     * sums the values reported under the same name across all workers.
+     */
+    class StatsRegistry
+    {
+    public:
+        using Emit = folly::FunctionRef<void(folly::StringPiece, uint64_t)>;
+        using Source = std::function<void(Emit)>;
+
+        static StatsRegistry &get();
+
+        uint64_t addSource(Source source);
+
+        void removeSource(uint64_t id);
+
+        std::map<std::string, uint64_t> collect() const;
+
+    private:
+        struct Sources
+        {
+            uint64_t nextId{1};
+            std::map<uint64_t, Source> sources;
+        };
+        folly::Synchronized<Sources> sources_;
+    };
+
+} // namespace quic::samples
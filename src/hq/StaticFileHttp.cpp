@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "StaticFileHttp.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <folly/Conv.h>
+#include <folly/String.h>
+
+namespace
+{
+    bool parseNumber(folly::StringPiece sp, uint64_t &out)
+    {
+        if (sp.empty())
+        {
+            return false;
+        }
+        for (auto c : sp)
+        {
+            if (c < '0' || c > '9')
+            {
+                return false;
+            }
+        }
+        auto result = folly::tryTo<uint64_t>(sp);
+        if (!result)
+        {
+            return false;
+        }
+        out = *result;
+        return true;
+    }
+
+    constexpr quic::samples::ContentCoding kCodings[] = {
+        quic::samples::ContentCoding::Brotli,
+        quic::samples::ContentCoding::Zstd,
+        quic::samples::ContentCoding::Gzip,
+    };
+}
+
+namespace quic::samples
+{
+    RangeResult parseRangeHeader(folly::StringPiece value,
+                                 uint64_t size,
+                                 std::vector<ByteRange> &ranges)
+    {
+        ranges.clear();
+        value = folly::trimWhitespace(value);
+        auto eq = value.find('=');
+        if (eq == folly::StringPiece::npos ||
+            !folly::trimWhitespace(value.subpiece(0, eq)).equals("bytes", folly::AsciiCaseInsensitive()))
+        {
+            return RangeResult::None;
+        }
+
+        std::vector<folly::StringPiece> specs;
+        folly::split(',', value.subpiece(eq + 1), specs);
+        size_t count = 0;
+        for (auto spec : specs)
+        {
+            spec = folly::trimWhitespace(spec);
+            if (spec.empty())
+            {
+                // Empty list elements are allowed and ignored
+                continue;
+            }
+            if (++count > kMaxRanges)
+            {
+                ranges.clear();
+                return RangeResult::None;
+            }
+            auto dash = spec.find('-');
+            if (dash == folly::StringPiece::npos)
+            {
+                ranges.clear();
+                return RangeResult::None;
+            }
+            auto firstSp = folly::trimWhitespace(spec.subpiece(0, dash));
+            auto lastSp = folly::trimWhitespace(spec.subpiece(dash + 1));
+            uint64_t first = 0;
+            uint64_t last = 0;
+            if (firstSp.empty())
+            {
+                // suffix-range: the final N bytes
+                uint64_t suffix = 0;
+                if (!parseNumber(lastSp, suffix))
+                {
+                    ranges.clear();
+                    return RangeResult::None;
+                }
+                if (suffix == 0 || size == 0)
+                {
+                    continue;
+                }
+                first = suffix >= size ? 0 : size - suffix;
+                last = size - 1;
+            }
+            else
+            {
+                if (!parseNumber(firstSp, first) ||
+                    (!lastSp.empty() && (!parseNumber(lastSp, last) || last < first)))
+                {
+                    ranges.clear();
+                    return RangeResult::None;
+                }
+                if (first >= size)
+                {
+                    continue;
+                }
+                if (lastSp.empty() || last >= size)
+                {
+                    last = size - 1;
+                }
+            }
+            ranges.push_back(ByteRange{first, last});
+        }
+        if (count == 0)
+        {
+            return RangeResult::None;
+        }
+        return ranges.empty() ? RangeResult::Unsatisfiable : RangeResult::Satisfiable;
+    }
+
+    bool ifRangeMatches(folly::StringPiece ifRange,
+                        folly::StringPiece etag,
+                        folly::StringPiece lastModified)
+    {
+        ifRange = folly::trimWhitespace(ifRange);
+        if (ifRange.startsWith("W/"))
+        {
+            // Weak validators never satisfy the strong comparison
+            return false;
+        }
+        if (ifRange.startsWith('"'))
+        {
+            return !etag.startsWith("W/") && ifRange == etag;
+        }
+        return !lastModified.empty() && ifRange == lastModified;
+    }
+
+    std::string formatContentRange(const ByteRange &range, uint64_t size)
+    {
+        return folly::to<std::string>("bytes ", range.first, "-", range.last, "/", size);
+    }
+
+    bool etagListContains(folly::StringPiece list,
+                          folly::StringPiece etag,
+                          bool weak)
+    {
+        auto opaque = [](folly::StringPiece tag)
+        {
+            tag.removePrefix("W/");
+            return tag;
+        };
+        bool etagWeak = etag.startsWith("W/");
+        list = folly::trimWhitespace(list);
+        if (list == "*")
+        {
+            return true;
+        }
+        while (!list.empty())
+        {
+            // entity-tags may contain commas inside the quotes
+            size_t start = list.startsWith("W/") ? 2 : 0;
+            size_t end;
+            if (list.size() > start && list[start] == '"')
+            {
+                end = list.find('"', start + 1);
+                end = end == folly::StringPiece::npos ? list.size() : end + 1;
+            }
+            else
+            {
+                end = std::min(list.find(','), list.size());
+            }
+            auto tag = folly::trimWhitespace(list.subpiece(0, end));
+            if (!tag.empty())
+            {
+                if (weak ? opaque(tag) == opaque(etag)
+                         : (!tag.startsWith("W/") && !etagWeak && tag == etag))
+                {
+                    return true;
+                }
+            }
+            list.advance(end);
+            auto comma = list.find(',');
+            if (comma == folly::StringPiece::npos)
+            {
+                break;
+            }
+            list = folly::trimWhitespace(list.subpiece(comma + 1));
+        }
+        return false;
+    }
+
+    time_t parseHttpDate(folly::StringPiece date)
+    {
+        static const char *kFormats[] = {
+            "%a, %d %b %Y %H:%M:%S GMT", // IMF-fixdate
+            "%A, %d-%b-%y %H:%M:%S GMT", // RFC 850
+            "%a %b %e %H:%M:%S %Y",      // asctime()
+        };
+        auto str = folly::trimWhitespace(date).str();
+        for (const auto *format : kFormats)
+        {
+            struct tm tm{};
+            const char *end = ::strptime(str.c_str(), format, &tm);
+            if (end && *end == '\0')
+            {
+                return ::timegm(&tm);
+            }
+        }
+        return -1;
+    }
+
+    std::string formatHttpDate(time_t time)
+    {
+        struct tm tm{};
+        ::gmtime_r(&time, &tm);
+        char buf[32];
+        ::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        return buf;
+    }
+
+    Precondition evaluateConditional(proxygen::HTTPMethod method,
+                                     folly::StringPiece ifNoneMatch,
+                                     folly::StringPiece ifModifiedSince,
+                                     folly::StringPiece etag,
+                                     time_t lastModified)
+    {
+        bool safe = method == proxygen::HTTPMethod::GET ||
+                    method == proxygen::HTTPMethod::HEAD;
+        if (!ifNoneMatch.empty())
+        {
+            if (!etagListContains(ifNoneMatch, etag, true))
+            {
+                return Precondition::Proceed;
+            }
+            return safe ? Precondition::NotModified : Precondition::Failed;
+        }
+        if (!ifModifiedSince.empty() && safe)
+        {
+            auto since = parseHttpDate(ifModifiedSince);
+            // A date in the future is invalid and ignored
+            if (since >= 0 && since <= ::time(nullptr) && lastModified <= since)
+            {
+                return Precondition::NotModified;
+            }
+        }
+        return Precondition::Proceed;
+    }
+
+    folly::StringPiece codingName(ContentCoding coding)
+    {
+        switch (coding)
+        {
+        case ContentCoding::Brotli:
+            return "br";
+        case ContentCoding::Zstd:
+            return "zstd";
+        case ContentCoding::Gzip:
+            return "gzip";
+        case ContentCoding::Identity:
+            break;
+        }
+        return "";
+    }
+
+    folly::StringPiece sidecarSuffix(ContentCoding coding)
+    {
+        switch (coding)
+        {
+        case ContentCoding::Brotli:
+            return ".br";
+        case ContentCoding::Zstd:
+            return ".zst";
+        case ContentCoding::Gzip:
+            return ".gz";
+        case ContentCoding::Identity:
+            break;
+        }
+        return "";
+    }
+
+    std::vector<ContentCoding> acceptedCodings(folly::StringPiece acceptEncoding)
+    {
+        // q-value of each entry of kCodings, -1 if not listed
+        double q[std::size(kCodings)] = {-1, -1, -1};
+        double wildcard = -1;
+        std::vector<folly::StringPiece> items;
+        folly::split(',', acceptEncoding, items);
+        for (auto item : items)
+        {
+            auto semi = item.find(';');
+            auto token = folly::trimWhitespace(item.subpiece(0, semi));
+            double weight = 1;
+            if (semi != folly::StringPiece::npos)
+            {
+                auto param = folly::trimWhitespace(item.subpiece(semi + 1));
+                if (param.size() > 2 &&
+                    (param.startsWith("q=") || param.startsWith("Q=")))
+                {
+                    auto parsed = folly::tryTo<double>(param.subpiece(2));
+                    weight = parsed ? std::clamp(*parsed, 0.0, 1.0) : 0;
+                }
+            }
+            if (token == "*")
+            {
+                wildcard = weight;
+                continue;
+            }
+            if (token.equals("x-gzip", folly::AsciiCaseInsensitive()))
+            {
+                token = "gzip";
+            }
+            for (size_t i = 0; i < std::size(kCodings); ++i)
+            {
+                if (token.equals(codingName(kCodings[i]), folly::AsciiCaseInsensitive()))
+                {
+                    q[i] = weight;
+                }
+            }
+        }
+        std::vector<size_t> order;
+        for (size_t i = 0; i < std::size(kCodings); ++i)
+        {
+            if (q[i] < 0)
+            {
+                q[i] = wildcard;
+            }
+            if (q[i] > 0)
+            {
+                order.push_back(i);
+            }
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [&q](size_t a, size_t b) { return q[a] > q[b]; });
+        std::vector<ContentCoding> codings;
+        codings.reserve(order.size());
+        for (auto i : order)
+        {
+            codings.push_back(kCodings[i]);
+        }
+        return codings;
+    }
+
+    std::string variantEtag(folly::StringPiece etag, ContentCoding coding)
+    {
+        if (coding == ContentCoding::Identity || !etag.endsWith('"'))
+        {
+            return etag.str();
+        }
+        etag.removeSuffix("\"");
+        return folly::to<std::string>(etag, "-", codingName(coding), "\"");
+    }
+
+} // namespace quic::samples
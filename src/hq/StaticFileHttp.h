@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <folly/Range.h>
+#include <proxygen/lib/http/HTTPMethod.h>
+
+/*
+ * HTTP semantics helpers for the static file handlers (RFC 9110).
+ */
+namespace quic::samples
+{
+    // Inclusive byte range of the selected representation
+    struct ByteRange
+    {
+        uint64_t first;
+        uint64_t last;
+
+        uint64_t length() const { return last - first + 1; }
+    };
+
+    enum class RangeResult
+    {
+        // No usable Range header: serve the full representation
+        None,
+        Satisfiable,
+        // Syntactically valid but no range overlaps the representation
+        Unsatisfiable,
+    };
+
+    /*
+     * Parses a "bytes" Range header value against a representation of the
+     * given size. Satisfiable ranges are clamped to the size and returned in
+     * request order. Unknown units, malformed values or more than
+     * kMaxRanges ranges yield RangeResult::None, which is always allowed.
+     */
+    constexpr size_t kMaxRanges = 16;
+    RangeResult parseRangeHeader(folly::StringPiece value,
+                                 uint64_t size,
+                                 std::vector<ByteRange> &ranges);
+
+    /*
+     * Evaluates If-Range: an entity tag must match strongly, a date must be
+     * identical to Last-Modified. Returns true if the Range header applies.
+     */
+    bool ifRangeMatches(folly::StringPiece ifRange,
+                        folly::StringPiece etag,
+                        folly::StringPiece lastModified);
+
+    std::string formatContentRange(const ByteRange &range, uint64_t size);
+
+    enum class Precondition
+    {
+        Proceed,
+        // Answer 304 without a body
+        NotModified,
+        // Answer 412
+        Failed,
+    };
+
+    /*
+     * Evaluates If-None-Match and If-Modified-Since for a representation
+     * with the given validators. If-None-Match uses the weak comparison and,
+     * when present, makes If-Modified-Since irrelevant. If-Modified-Since is
+     * only considered for GET and HEAD.
+     */
+    Precondition evaluateConditional(proxygen::HTTPMethod method,
+                                     folly::StringPiece ifNoneMatch,
+                                     folly::StringPiece ifModifiedSince,
+                                     folly::StringPiece etag,
+                                     time_t lastModified);
+
+    // True if etag is listed in an If-None-Match/If-Match style list
+    bool etagListContains(folly::StringPiece list,
+                          folly::StringPiece etag,
+                          bool weak);
+
+    // Parses an IMF-fixdate, RFC 850 or asctime() date; -1 if invalid
+    time_t parseHttpDate(folly::StringPiece date);
+
+    // Formats an IMF-fixdate
+    std::string formatHttpDate(time_t time);
+
+    enum class ContentCoding
+    {
+        Identity,
+        Brotli,
+        Zstd,
+        Gzip,
+    };
+
+    // Content-Encoding token, empty for identity
+    folly::StringPiece codingName(ContentCoding coding);
+
+    // Extension of the precompressed sidecar file, empty for identity
+    folly::StringPiece sidecarSuffix(ContentCoding coding);
+
+    /*
+     * Returns the codings an Accept-Encoding value allows, best first by
+     * q-value with ties going to the better ratio (br, zstd, gzip). "*"
+     * covers the codings not listed; q=0 excludes a coding. Identity is
+     * never listed, the caller falls back to it.
+     */
+    std::vector<ContentCoding> acceptedCodings(folly::StringPiece acceptEncoding);
+
+    // Derives the entity tag of an encoded variant so it never matches the
+    // identity representation: "x" becomes "x-br"
+    std::string variantEtag(folly::StringPiece etag, ContentCoding coding);
+
+} // namespace quic::samples
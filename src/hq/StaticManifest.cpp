@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "StaticManifest.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <folly/File.h>
+#include <folly/FileUtil.h>
+#include <folly/Format.h>
+#include <folly/hash/SpookyHashV2.h>
+#include <folly/portability/GFlags.h>
+#include <folly/synchronization/Rcu.h>
+#include <glog/logging.h>
+
+#include "MimeTypes.h"
+#include "ServerStats.h"
+
+DEFINE_bool(static_manifest,
+            true,
+            "Index --static_root in the background to serve content-hash "
+            "ETags that survive deploys of unchanged files");
+DEFINE_uint64(static_manifest_hash_max_mb,
+              256,
+              "Larger static files are not hashed and keep a size-mtime ETag");
+DEFINE_uint32(static_manifest_debounce_ms,
+              200,
+              "Quiet time after a change below --static_root before the "
+              "manifest is rebuilt");
+
+namespace
+{
+    constexpr size_t kHashChunk = 256 << 10;
+    constexpr uint32_t kDirMask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                                  IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+    bool sameVersion(const struct stat &a, const struct stat &b)
+    {
+        return a.st_ino == b.st_ino && a.st_size == b.st_size &&
+               a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+    }
+
+    // Hashes the file through one descriptor and fills st from it. Returns
+    // false if it can't be read or changed while being hashed.
+    bool hashFile(const std::string &file, std::string &etag, struct stat &st, uint64_t &hashed)
+    {
+        int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        folly::File guard(fd, true);
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            return false;
+        }
+        folly::hash::SpookyHashV2 spooky;
+        spooky.Init(0, 0);
+        auto buf = std::make_unique<char[]>(kHashChunk);
+        while (true)
+        {
+            auto n = folly::readNoInt(fd, buf.get(), kHashChunk);
+            if (n < 0)
+            {
+                return false;
+            }
+            if (n == 0)
+            {
+                break;
+            }
+            spooky.Update(buf.get(), n);
+            hashed += n;
+        }
+        struct stat after{};
+        if (::fstat(fd, &after) != 0 || !sameVersion(st, after))
+        {
+            // Being written: the next inotify event brings us back
+            return false;
+        }
+        uint64_t h1 = 0;
+        uint64_t h2 = 0;
+        spooky.Final(&h1, &h2);
+        // Same digest asset_packer uses, so a file keeps its ETag whether
+        // it is served from a bundle or from the root
+        etag = folly::sformat("\"{:016x}{:016x}\"", h1, h2);
+        return true;
+    }
+}
+
+namespace quic::samples
+{
+    // Owns the background thread; lives until exit
+    class ManifestIndexer
+    {
+    public:
+        static std::atomic<StaticManifest *> current;
+        static std::atomic<uint64_t> generation;
+
+        explicit ManifestIndexer(std::string root) : root_(std::move(root))
+        {
+            statsId_ = StatsRegistry::get().addSource(
+                [this](StatsRegistry::Emit emit)
+                {
+                    emit("manifest.entries", entries_.get());
+                    emit("manifest.builds", builds_.get());
+                    emit("manifest.hashed_bytes", hashedBytes_.get());
+                });
+        }
+
+        void run()
+        {
+            int fd = ::inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+            if (fd < 0)
+            {
+                PLOG(ERROR) << "inotify_init1 failed, the static manifest won't follow changes";
+            }
+            else
+            {
+                inotify_ = folly::File(fd, true);
+            }
+            publish();
+            while (inotify_ && waitForChanges())
+            {
+                publish();
+            }
+        }
+
+    private:
+        // Blocks until something changed and then stayed quiet for the
+        // debounce time, so a deploy is indexed once, not per file
+        bool waitForChanges()
+        {
+            int timeout = -1;
+            while (true)
+            {
+                struct pollfd pfd{inotify_.fd(), POLLIN, 0};
+                int ready = ::poll(&pfd, 1, timeout);
+                if (ready < 0 && errno != EINTR)
+                {
+                    PLOG(ERROR) << "Polling the static root watch failed";
+                    return false;
+                }
+                if (ready == 0)
+                {
+                    return true;
+                }
+                alignas(struct inotify_event) char buf[4096];
+                while (folly::readNoInt(inotify_.fd(), buf, sizeof(buf)) > 0)
+                {
+                }
+                timeout = FLAGS_static_manifest_debounce_ms;
+            }
+        }
+
+        void publish()
+        {
+            auto next = build(current.load(std::memory_order_acquire));
+            entries_.set(next->size());
+            builds_.add();
+            VLOG(2) << "Indexed " << next->size() << " static files below " << root_;
+            auto *previous = current.exchange(next.release(), std::memory_order_acq_rel);
+            generation.fetch_add(1, std::memory_order_release);
+            if (previous)
+            {
+                // Freed once every reader that could see it is done
+                folly::rcu_retire(previous);
+            }
+        }
+
+        // Files whose inode, size and mtime did not change keep the digest
+        // from the previous build
+        std::unique_ptr<StaticManifest> build(const StaticManifest *previous)
+        {
+            namespace fs = std::filesystem;
+            auto next = std::make_unique<StaticManifest>();
+            std::error_code ec;
+            watch(root_);
+            fs::recursive_directory_iterator it(
+                root_, fs::directory_options::skip_permission_denied, ec);
+            for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+            {
+                const auto &dirent = *it;
+                std::error_code typeEc;
+                if (dirent.is_directory(typeEc))
+                {
+                    watch(dirent.path().string());
+                    continue;
+                }
+                if (!dirent.is_regular_file(typeEc))
+                {
+                    continue;
+                }
+                auto rel = fs::relative(dirent.path(), root_, typeEc).generic_string();
+                struct stat st{};
+                if (typeEc || ::stat(dirent.path().c_str(), &st) != 0)
+                {
+                    continue;
+                }
+                if (previous)
+                {
+                    auto old = previous->entries_.find(rel);
+                    if (old != previous->entries_.end() && old->second.matches(st))
+                    {
+                        next->entries_.emplace(rel, old->second);
+                        continue;
+                    }
+                }
+                if (uint64_t(st.st_size) > (FLAGS_static_manifest_hash_max_mb << 20))
+                {
+                    continue;
+                }
+                ManifestEntry entry;
+                uint64_t hashed = 0;
+                bool ok = hashFile(dirent.path().string(), entry.etag, st, hashed);
+                hashedBytes_.add(hashed);
+                if (!ok)
+                {
+                    continue;
+                }
+                // A sidecar is indexed as the file it is; the handler serving
+                // it for its base file uses the base file's type
+                entry.contentType = mimeTypeFor(rel);
+                entry.size = st.st_size;
+                entry.mtime = st.st_mtim;
+                entry.dev = st.st_dev;
+                entry.ino = st.st_ino;
+                next->entries_.emplace(std::move(rel), std::move(entry));
+            }
+            if (ec)
+            {
+                LOG(WARNING) << "Indexing " << root_ << " stopped early: " << ec.message();
+            }
+            return next;
+        }
+
+        void watch(const std::string &dir)
+        {
+            // Adding a watch twice returns the existing one
+            if (inotify_ && ::inotify_add_watch(inotify_.fd(), dir.c_str(), kDirMask) < 0)
+            {
+                PLOG(WARNING) << "Can't watch " << dir << ", changes below it go unnoticed";
+            }
+        }
+
+        const std::string root_;
+        folly::File inotify_;
+        WorkerCounter entries_;
+        WorkerCounter builds_;
+        WorkerCounter hashedBytes_;
+        uint64_t statsId_{0};
+    };
+
+    std::atomic<StaticManifest *> ManifestIndexer::current{nullptr};
+    std::atomic<uint64_t> ManifestIndexer::generation{0};
+
+    void StaticManifest::start(const std::string &root)
+    {
+        static std::once_flag started;
+        std::call_once(started,
+                       [&root]
+                       {
+                           if (!FLAGS_static_manifest)
+                           {
+                               return;
+                           }
+                           auto *indexer = new ManifestIndexer(root);
+                           std::thread([indexer] { indexer->run(); }).detach();
+                       });
+    }
+
+    uint64_t StaticManifest::generation()
+    {
+        return ManifestIndexer::generation.load(std::memory_order_acquire);
+    }
+
+    std::optional<ManifestEntry> StaticManifest::lookup(folly::StringPiece path)
+    {
+        folly::rcu_reader guard;
+        const auto *manifest = ManifestIndexer::current.load(std::memory_order_acquire);
+        if (!manifest)
+        {
+            return std::nullopt;
+        }
+        auto it = manifest->entries_.find(path.str());
+        if (it == manifest->entries_.end())
+        {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+} // namespace quic::samples
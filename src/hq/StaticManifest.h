@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <sys/stat.h>
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <folly/Range.h>
+
+namespace quic::samples
+{
+    struct ManifestEntry
+    {
+        // Strong validator derived from the file contents
+        std::string etag;
+        std::string_view contentType;
+        uint64_t size{0};
+        struct timespec mtime{};
+        dev_t dev{0};
+        ino_t ino{0};
+
+        // True if the entry still describes the file st was taken from
+        bool matches(const struct stat &st) const
+        {
+            return st.st_dev == dev && st.st_ino == ino && uint64_t(st.st_size) == size &&
+                   st.st_mtim.tv_sec == mtime.tv_sec && st.st_mtim.tv_nsec == mtime.tv_nsec;
+        }
+    };
+
+    /*
+     * Immutable index of the files below --static_root, keyed by path
+     * relative to the root.
+     *
+     * A background thread builds it at startup and rebuilds it when inotify
+     * reports changes, hashing only files whose inode, size or mtime moved.
+     * Each build is published with RCU: lookups take no lock and never wait
+     * for the indexer, which retires the previous manifest once no reader
+     * can still see it. A deploy that rewrites files with identical bytes
+     * keeps their ETags, so client caches survive it.
+     */
+    class StaticManifest
+    {
+    public:
+        // Starts indexing root; later calls are ignored
+        static void start(const std::string &root);
+
+        // Copy of the entry for a root relative path, if indexed
+        static std::optional<ManifestEntry> lookup(folly::StringPiece path);
+
+        // Number of manifests published so far; moves with every build
+        static uint64_t generation();
+
+        size_t size() const { return entries_.size(); }
+
+    private:
+        friend class ManifestIndexer;
+
+        std::unordered_map<std::string, ManifestEntry> entries_;
+    };
+
+} // namespace quic::samples
@@ -112,7 +112,8 @@ namespace websockethandler
     /*
      * Websocket acceptor.
      */
-    class WebSocketHandler : public quic::samples::BaseSampleHandler
+    class WebSocketHandler : public quic::samples::BaseSampleHandler,
+                             public quic::samples::PooledHandler<WebSocketHandler>
     {
     public:
         explicit WebSocketHandler(const HandlerParams &params, folly::EventBase *evb)
@@ -10,11 +10,13 @@
 
 #include <folly/init/Init.h>
 
+#include "hq/AffinityPlan.h"
 #include "hq/ConnIdLogger.h"
 //#include <proxygen/httpserver/samples/hq/HQClient.h>
 #include "hq/HQCommandLine.h"
 #include "hq/HQParams.h"
 #include "hq/HQServerModule.h"
+#include "hq/IoUringProfile.h"
 #include <proxygen/lib/transport/PersistentQuicPskCache.h>
 #include <folly/io/async/IoUringBackend.h>
 #include <folly/io/async/EventBaseManager.h>
@@ -31,21 +33,6 @@
 
 using namespace quic::samples;
 
-DEFINE_bool(use_iouring_event_eventfd, true, "");
-DEFINE_int32(io_capacity, 256, "");
-DEFINE_int32(io_submit_sqe, 0, "");
-DEFINE_int32(io_max_get, 0, "");
-DEFINE_bool(set_iouring_defer_taskrun, true, "");
-DEFINE_int32(io_max_submit, 0, "");
-DEFINE_int32(io_registers, 2048, "");
-DEFINE_int32(io_prov_buffs_size, 2048, "");
-DEFINE_int32(io_prov_buffs, 2000, "");
-DEFINE_bool(io_zcrx, false, "");
-DEFINE_int32(io_zcrx_num_pages, 16384, "");
-DEFINE_int32(io_zcrx_refill_entries, 16384, "");
-DEFINE_string(io_zcrx_ifname, "eth0", "");
-DEFINE_int32(io_zcrx_queue_id, 0, "");
-
 void setMaxOpenFds(rlim_t new_limit)
 {
   struct rlimit rl;
@@ -85,84 +72,6 @@ void setMaxOpenFds(rlim_t new_limit)
   }
 }
 
-#if FOLLY_HAVE_WEAK_SYMBOLS
-FOLLY_ATTR_WEAK int resolve_napi_callback(
-    int /*ifindex*/, uint32_t /*queueId*/);
-#else
-static int resolve_napi_callback(int /*ifindex*/, uint32_t /*queueId*/)
-{
-  return -1;
-}
-#endif
-
-folly::IoUringBackend::Options getIoUringOptions()
-{
-  // folly::IoUringBackend::Options options;
-  // options.setRegisterRingFd(FLAGS_use_iouring_event_eventfd);
-
-  // if (FLAGS_io_prov_buffs_size > 0 && FLAGS_io_prov_buffs > 0)
-  // {
-  //   options.setInitialProvidedBuffers(
-  //       FLAGS_io_prov_buffs_size, FLAGS_io_prov_buffs);
-  // }
-
-  // if (FLAGS_io_registers > 0)
-  // {
-  //   options.setUseRegisteredFds(static_cast<size_t>(FLAGS_io_registers));
-  // }
-
-  // if (FLAGS_io_capacity > 0)
-  // {
-  //   options.setCapacity(static_cast<size_t>(FLAGS_io_capacity));
-  // }
-
-  // if (FLAGS_io_submit_sqe > 0)
-  // {
-  //   options.setSqeSize(FLAGS_io_submit_sqe);
-  // }
-
-  // if (FLAGS_io_max_get > 0)
-  // {
-  //   options.setMaxGet(static_cast<size_t>(FLAGS_io_max_get));
-  // }
-
-  // if (FLAGS_io_max_submit > 0)
-  // {
-  //   options.setMaxSubmit(static_cast<size_t>(FLAGS_io_max_submit));
-  // }
-
-  // if (FLAGS_set_iouring_defer_taskrun)
-  // {
-  //   if (folly::IoUringBackend::kernelSupportsDeferTaskrun())
-  //   {
-  //     options.setDeferTaskRun(FLAGS_set_iouring_defer_taskrun);
-  //   }
-  //   else
-  //   {
-  //     LOG(ERROR) << "not setting DeferTaskRun as not supported on this kernel";
-  //   }
-  // }
-
-  // static std::atomic<int32_t> currQueueId{FLAGS_io_zcrx_queue_id};
-  // if (FLAGS_io_zcrx)
-  // {
-  //   options.setZeroCopyRx(true)
-  //       .setZeroCopyRxInterface(FLAGS_io_zcrx_ifname)
-  //       .setZeroCopyRxQueue(currQueueId.fetch_add(1))
-  //       .setZeroCopyRxNumPages(FLAGS_io_zcrx_num_pages)
-  //       .setZeroCopyRxRefillEntries(FLAGS_io_zcrx_refill_entries)
-  //       .setResolveNapiCallback(resolve_napi_callback);
-  // }
-  folly::IoUringBackend::Options options;
-  options.setRegisterRingFd(true)
-      .setInitialProvidedBuffers(2048, 2000)
-      .setUseRegisteredFds(2048)
-      .setDeferTaskRun(true)
-      .setCapacity(512);
-  return options;
-}
-
-
 std::unique_ptr<folly::EventBaseBackendBase> getEventBaseDetails()
   {
     //folly::EventBaseBackendBase ret;
@@ -175,47 +84,17 @@ std::unique_ptr<folly::EventBaseBackendBase> getEventBaseDetails()
 
   std::unique_ptr<folly::EventBaseBackendBase> getEventBaseBackendFunc()
   {
-#if FOLLY_HAS_LIBURING
-    try
-    {
-      // TODO numa node affinitization
-      // static int sqSharedCore = 0;
-      // LOG(INFO) << "Sharing eb sq poll on core: " << sqSharedCore;
-      // options.setSQGroupName("fast_eb").setSQCpu(sqSharedCore);
-      return std::make_unique<folly::IoUringBackend>(getIoUringOptions());
-    }
-    catch (const std::exception &ex)
-    {
-      LOG(FATAL) << "Failed to create io_uring backend: "
-                 << folly::exceptionStr(ex);
-    }
-#else
-    LOG(FATAL) << "io_uring not supported";
-#endif
+    AffinityPlan::get().pinWorkerThread();
+    return IoUringProfile::makeBackend();
   }
 
-  folly::IoUringBackend::Options getDefaultIOUringOptions()
-{
-    folly::IoUringBackend::Options options;
-    options.setRegisterRingFd(true)
-        .setInitialProvidedBuffers(2048, 2000)
-        .setUseRegisteredFds(2048)
-        .setDeferTaskRun(true)
-        .setCapacity(512);
-    return options;
-}
-
 std::unique_ptr<folly::EventBaseBackendBase> getIOUringEventbaseBackendFunc()
 {
-    try
-    {
-        return std::make_unique<folly::IoUringBackend>(getDefaultIOUringOptions());
-    }
-    catch (const std::exception &ex)
-    {
-        LOG(FATAL) << "Failed to create io_uring backend: "
-                   << folly::exceptionStr(ex);
-    }
+    // Runs on the thread creating the event base, so a worker is pinned
+    // before its ring is set up. Same profile for every event base; epoll
+    // if io_uring is unavailable
+    AffinityPlan::get().pinWorkerThread();
+    return IoUringProfile::makeBackend();
 }
 
 std::shared_ptr<folly::IOThreadPoolExecutorBase> getDefaultIOUringExecutor(
@@ -258,6 +137,7 @@ namespace folly
   setMaxOpenFds(262144);
   if(1){
         // Preinitialize EventBase with custom settings on startup.
+        LOG(INFO) << "Event base backend: " << IoUringProfile::get().describe();
 #if 1
         folly::EventBaseBackendBase::FactoryFunc func(getIOUringEventbaseBackendFunc);
         static folly::EventBaseManager ebm(
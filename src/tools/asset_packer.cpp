@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/*
+ * Packs a directory of static assets into one bundle file for
+ * --static_bundle (see hq/BundleFormat.h). foo.br, foo.zst and foo.gz next
+ * to foo become its precompressed variants. The bundle is written to a
+ * temporary file and renamed over --output, so a running server picks up
+ * the new release atomically.
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <folly/Conv.h>
+#include <folly/File.h>
+#include <folly/FileUtil.h>
+#include <folly/Format.h>
+#include <folly/String.h>
+#include <folly/init/Init.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+
+#include "BundleFormat.h"
+#include "MimeTypes.h"
+
+DEFINE_string(input, "", "Directory of assets to pack");
+DEFINE_string(output, "", "Bundle file to write");
+
+namespace
+{
+    using namespace quic::samples;
+
+    constexpr uint64_t kPageSize = 4096;
+    // Bucket search gives up past this many seeds; never hit at the load
+    // factors below
+    constexpr uint32_t kMaxSeed = 1u << 24;
+
+    struct Asset
+    {
+        std::string path;
+        std::string type;
+        int64_t mtime{0};
+        // Source file of each variant, empty if absent
+        std::string sources[kBundleVariants];
+        uint64_t sizes[kBundleVariants]{};
+        std::string etags[kBundleVariants];
+    };
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    struct stat statOrThrow(const std::string &file)
+    {
+        struct stat st{};
+        if (::stat(file.c_str(), &st) != 0)
+        {
+            throw std::runtime_error(
+                folly::to<std::string>("Can't stat ", file, ": ", folly::errnoStr(errno)));
+        }
+        return st;
+    }
+
+    std::string readOrThrow(const std::string &file)
+    {
+        std::string contents;
+        if (!folly::readFile(file.c_str(), contents))
+        {
+            throw std::runtime_error(
+                folly::to<std::string>("Can't read ", file, ": ", folly::errnoStr(errno)));
+        }
+        return contents;
+    }
+
+    // Strong validator over a variant's bytes, so an unchanged asset keeps
+    // its ETag across releases. Same digest as the StaticManifest's.
+    std::string contentEtag(const std::string &contents)
+    {
+        uint64_t h1 = 0;
+        uint64_t h2 = 0;
+        folly::hash::SpookyHashV2::Hash128(contents.data(), contents.size(), &h1, &h2);
+        return folly::sformat("\"{:016x}{:016x}\"", h1, h2);
+    }
+
+    std::vector<Asset> collect(const std::string &root)
+    {
+        namespace fs = std::filesystem;
+        std::map<std::string, std::string> files;
+        for (const auto &dirent : fs::recursive_directory_iterator(root))
+        {
+            if (dirent.is_regular_file())
+            {
+                auto rel = fs::relative(dirent.path(), root).generic_string();
+                files.emplace("/" + rel, dirent.path().string());
+            }
+        }
+
+        std::map<std::string, Asset> assets;
+        auto variantOf = [&files](const std::string &path, size_t &variant)
+        {
+            for (variant = 1; variant < kBundleVariants; ++variant)
+            {
+                folly::StringPiece suffix(kBundleVariantSuffixes[variant]);
+                if (folly::StringPiece(path).endsWith(suffix) &&
+                    files.count(path.substr(0, path.size() - suffix.size())))
+                {
+                    return path.substr(0, path.size() - suffix.size());
+                }
+            }
+            variant = 0;
+            return path;
+        };
+        for (const auto &[path, source] : files)
+        {
+            size_t variant = 0;
+            auto base = variantOf(path, variant);
+            auto &asset = assets[base];
+            asset.path = base;
+            asset.sources[variant] = source;
+            asset.sizes[variant] = statOrThrow(source).st_size;
+            asset.etags[variant] = contentEtag(readOrThrow(source));
+            if (variant == 0)
+            {
+                asset.type = std::string(mimeTypeFor(base));
+                asset.mtime = statOrThrow(source).st_mtime;
+            }
+        }
+
+        std::vector<Asset> result;
+        result.reserve(assets.size());
+        for (auto &entry : assets)
+        {
+            result.push_back(std::move(entry.second));
+        }
+        return result;
+    }
+
+    // Hash-and-displace: buckets are placed largest first, each with the
+    // first seed that sends all its paths to free, distinct slots
+    void buildIndex(const std::vector<Asset> &assets,
+                    BundleHeader &header,
+                    std::vector<uint32_t> &seeds,
+                    std::vector<uint32_t> &slots)
+    {
+        size_t n = assets.size();
+        header.numBuckets = std::max<uint32_t>(1, (n + 3) / 4);
+        header.numSlots = std::max<uint32_t>(1, n + n / 4);
+        std::vector<std::vector<uint32_t>> buckets(header.numBuckets);
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            buckets[bundleHash(assets[i].path, 0) % header.numBuckets].push_back(i);
+        }
+        std::vector<uint32_t> order(header.numBuckets);
+        for (uint32_t b = 0; b < header.numBuckets; ++b)
+        {
+            order[b] = b;
+        }
+        std::stable_sort(order.begin(),
+                         order.end(),
+                         [&buckets](uint32_t a, uint32_t b)
+                         { return buckets[a].size() > buckets[b].size(); });
+
+        seeds.assign(header.numBuckets, 0);
+        slots.assign(header.numSlots, kEmptySlot);
+        std::vector<uint32_t> taken;
+        for (auto b : order)
+        {
+            const auto &bucket = buckets[b];
+            if (bucket.empty())
+            {
+                break;
+            }
+            uint32_t seed = 1;
+            for (; seed < kMaxSeed; ++seed)
+            {
+                taken.clear();
+                bool ok = true;
+                for (auto i : bucket)
+                {
+                    uint32_t slot = bundleHash(assets[i].path, seed) % header.numSlots;
+                    if (slots[slot] != kEmptySlot ||
+                        std::find(taken.begin(), taken.end(), slot) != taken.end())
+                    {
+                        ok = false;
+                        break;
+                    }
+                    taken.push_back(slot);
+                }
+                if (ok)
+                {
+                    break;
+                }
+            }
+            if (seed == kMaxSeed)
+            {
+                throw std::runtime_error("No perfect hash found for the asset paths");
+            }
+            seeds[b] = seed;
+            for (size_t k = 0; k < bucket.size(); ++k)
+            {
+                slots[taken[k]] = bucket[k];
+            }
+        }
+    }
+
+    void writeOrThrow(int fd, const void *data, size_t size)
+    {
+        if (folly::writeFull(fd, data, size) != static_cast<ssize_t>(size))
+        {
+            throw std::runtime_error(
+                folly::to<std::string>("Write failed: ", folly::errnoStr(errno)));
+        }
+    }
+
+    void pad(int fd, uint64_t &offset, uint64_t to)
+    {
+        std::string zeros(to - offset, '\0');
+        writeOrThrow(fd, zeros.data(), zeros.size());
+        offset = to;
+    }
+
+    void pack(const std::string &input, const std::string &output)
+    {
+        auto assets = collect(input);
+        BundleHeader header{};
+        std::memcpy(header.magic, kBundleMagic, sizeof(kBundleMagic));
+        header.version = kBundleVersion;
+        header.count = assets.size();
+        std::vector<uint32_t> seeds;
+        std::vector<uint32_t> slots;
+        buildIndex(assets, header, seeds, slots);
+
+        std::string strings;
+        auto addString = [&strings](const std::string &value)
+        {
+            BundleSpan span{strings.size(), value.size()};
+            strings += value;
+            return span;
+        };
+        std::vector<BundleEntry> entries(assets.size());
+        for (size_t i = 0; i < assets.size(); ++i)
+        {
+            entries[i].path = addString(assets[i].path);
+            entries[i].type = addString(assets[i].type);
+            entries[i].mtime = assets[i].mtime;
+            for (size_t v = 0; v < kBundleVariants; ++v)
+            {
+                entries[i].etags[v] = addString(assets[i].etags[v]);
+            }
+        }
+        header.stringsSize = strings.size();
+        header.dataOffset = alignUp(stringsOffset(header) + header.stringsSize, kPageSize);
+        uint64_t dataEnd = header.dataOffset;
+        for (size_t i = 0; i < assets.size(); ++i)
+        {
+            for (size_t v = 0; v < kBundleVariants; ++v)
+            {
+                if (!assets[i].sources[v].empty())
+                {
+                    entries[i].variants[v] = {dataEnd, assets[i].sizes[v]};
+                    dataEnd += assets[i].sizes[v];
+                }
+            }
+        }
+
+        auto tmp = output + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            throw std::runtime_error(
+                folly::to<std::string>("Can't create ", tmp, ": ", folly::errnoStr(errno)));
+        }
+        folly::File file(fd, true);
+        uint64_t offset = 0;
+        writeOrThrow(fd, &header, sizeof(header));
+        writeOrThrow(fd, seeds.data(), seeds.size() * sizeof(uint32_t));
+        writeOrThrow(fd, slots.data(), slots.size() * sizeof(uint32_t));
+        offset = slotsOffset(header) + slots.size() * sizeof(uint32_t);
+        pad(fd, offset, entriesOffset(header));
+        writeOrThrow(fd, entries.data(), entries.size() * sizeof(BundleEntry));
+        writeOrThrow(fd, strings.data(), strings.size());
+        offset = stringsOffset(header) + strings.size();
+        pad(fd, offset, header.dataOffset);
+        for (size_t i = 0; i < assets.size(); ++i)
+        {
+            for (size_t v = 0; v < kBundleVariants; ++v)
+            {
+                if (assets[i].sources[v].empty())
+                {
+                    continue;
+                }
+                auto contents = readOrThrow(assets[i].sources[v]);
+                if (contents.size() != assets[i].sizes[v])
+                {
+                    throw std::runtime_error(
+                        folly::to<std::string>(assets[i].sources[v], " changed while packing"));
+                }
+                writeOrThrow(fd, contents.data(), contents.size());
+            }
+        }
+        if (::fsync(fd) != 0 || ::rename(tmp.c_str(), output.c_str()) != 0)
+        {
+            throw std::runtime_error(
+                folly::to<std::string>("Can't publish ", output, ": ", folly::errnoStr(errno)));
+        }
+        LOG(INFO) << "Packed " << assets.size() << " assets, " << dataEnd << " bytes into "
+                  << output;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    folly::init(&argc, &argv, true);
+    if (FLAGS_input.empty() || FLAGS_output.empty())
+    {
+        LOG(ERROR) << "Usage: asset_packer --input=<dir> --output=<bundle>";
+        return 1;
+    }
+    try
+    {
+        pack(FLAGS_input, FLAGS_output);
+    }
+    catch (const std::exception &ex)
+    {
+        LOG(ERROR) << ex.what();
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/*
+ * Handler allocation per request with and without the slab pool (see
+ * hq/HandlerPool.h). Each request takes the Dispatcher's steps that touch
+ * the allocator: match the path in a RouteTable, create the handler
+ * through the route's factory and delete it as detachTransaction does.
+ *
+ * The handlers stand in for DummyHandler: the same members, without the
+ * proxygen transaction plumbing, so the tool links without the server.
+ * allocs_per_1k_req counts calls into the global operator new; the
+ * pooled handler itself only reaches it once per slab, the message string
+ * on every request.
+ *
+ *   handler_pool_bench --bm_min_iters=100000
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/init/Init.h>
+
+#include "HandlerPool.h"
+#include "RouteTable.h"
+
+namespace
+{
+    // Single threaded: the benchmark runs on the main thread only
+    size_t allocations = 0;
+
+    using namespace quic::samples;
+
+    // Members of BaseSampleHandler and DummyHandler that are built per request
+    class PlainHandler
+    {
+    public:
+        explicit PlainHandler(std::string version) : version_(std::move(version)) {}
+        virtual ~PlainHandler() = default;
+
+    private:
+        std::string version_;
+        void *txn_{nullptr};
+        const std::string message_ =
+            folly::to<std::string>("you reached mvfst.net, ",
+                                   "reach the /echo endpoint for an echo response ",
+                                   "query /<number> endpoints for a variable size "
+                                   "response with random bytes");
+    };
+
+    class PooledBenchHandler : public PlainHandler, public PooledHandler<PooledBenchHandler>
+    {
+    public:
+        using PlainHandler::PlainHandler;
+    };
+
+    template <class Handler>
+    const RouteTable &routeTable()
+    {
+        static const RouteFactory factory = [](proxygen::HTTPMessage &, const RouteMatch &)
+        { return reinterpret_cast<BaseSampleHandler *>(new Handler("HTTP/3")); };
+        static const RouteTable table({{"/status", factory, {}}, {"/delay*", factory, {}}},
+                                      Route{"/*", factory, {}});
+        return table;
+    }
+
+    template <class Handler>
+    void dispatch(folly::UserCounters &counters, size_t iters)
+    {
+        const auto &table = routeTable<Handler>();
+        proxygen::HTTPMessage msg;
+        size_t before = 0;
+        BENCHMARK_SUSPEND
+        {
+            // Leaves a warm pool, as a worker has after its first requests
+            delete reinterpret_cast<Handler *>(table.match("/").route->factory(msg, {}));
+            before = allocations;
+        }
+        for (size_t i = 0; i < iters; ++i)
+        {
+            auto match = table.match("/index.html");
+            auto *handler = reinterpret_cast<Handler *>(match.route->factory(msg, match));
+            folly::doNotOptimizeAway(handler);
+            delete handler;
+        }
+        BENCHMARK_SUSPEND
+        {
+            counters["allocs_per_1k_req"] =
+                int64_t((allocations - before) * 1000 / std::max<size_t>(iters, 1));
+        }
+    }
+}
+
+void *operator new(size_t size)
+{
+    ++allocations;
+    if (void *p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+BENCHMARK_COUNTERS(globalAllocator, counters, iters)
+{
+    dispatch<PlainHandler>(counters, iters);
+}
+
+BENCHMARK_COUNTERS_RELATIVE(slabPool, counters, iters)
+{
+    dispatch<PooledBenchHandler>(counters, iters);
+}
+
+int main(int argc, char *argv[])
+{
+    folly::init(&argc, &argv, true);
+    folly::runBenchmarks();
+    return 0;
+}